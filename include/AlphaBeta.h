@@ -0,0 +1,243 @@
+#ifndef ALPHABETA_H
+#define ALPHABETA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Instrumentation.h"
+
+/* The eight symmetries of an N x N board, acting on squares numbered row by
+ * row. Symmetry 0 is the identity, 1-3 rotate by 90, 180 and 270 degrees
+ * and 4-7 are the four reflections.
+ */
+template <int N>
+struct Dihedral {
+  static const int NUM_SYMMETRIES = 8;
+
+  static int map(int square, int symmetry) {
+    int row = square / N;
+    int col = square % N;
+    int last = N - 1;
+    switch (symmetry) {
+      case 1:
+        return col * N + (last - row);
+      case 2:
+        return (last - row) * N + (last - col);
+      case 3:
+        return (last - col) * N + row;
+      case 4:
+        return row * N + (last - col);
+      case 5:
+        return (last - row) * N + col;
+      case 6:
+        return col * N + row;
+      case 7:
+        return (last - col) * N + (last - row);
+      default:
+        return square;
+    }
+  }
+
+  // Only the quarter turns are not their own inverse
+  static int inverse(int symmetry) {
+    if (symmetry == 1) {
+      return 3;
+    }
+    if (symmetry == 3) {
+      return 1;
+    }
+    return symmetry;
+  }
+};
+
+/* Negamax alpha-beta search with iterative deepening and a transposition
+ * table, usable with any two-player game that provides a position type
+ * with:
+ *   static const int MAX_MOVES;
+ *   int moves(int *out) const;           // legal moves, returns the count
+ *   void play(int move);
+ *   void undo(int move);
+ *   bool terminal(int *value) const;     // value for the side to move
+ *   int evaluate() const;                // heuristic at the depth limit
+ *   uint64_t key(int *symmetry) const;   // canonical key of the position
+ *   static int mapMove(int move, int symmetry);    // into the key's frame
+ *   static int unmapMove(int move, int symmetry);  // back out of it
+ * Values are from the point of view of the side to move and must depend on
+ * the position only, e.g. a faster win is worth more because fewer pieces
+ * are on the board, not because fewer plies were searched. Positions that
+ * are symmetric to each other should return the same key, so they share a
+ * table entry; best moves are stored in the key's frame. Games without
+ * symmetry return symmetry 0 and map moves to themselves.
+ */
+template <class Position>
+class AlphaBeta {
+ public:
+  static const int INFINITE_VALUE = 1000000;
+  // Depth stored for values that did not depend on the depth limit
+  static const int16_t SOLVED = 0x7FFF;
+
+  AlphaBeta(unsigned int tableBits = 16);
+
+  // Searches 1, 2, ... maxDepth plies deep, stopping early once a depth
+  // is searched without reaching the limit, i.e. the value is exact.
+  // Returns the value and writes the best move, -1 if there is none.
+  int search(Position &position, int maxDepth, int *bestMove);
+  // Value of playing 'move', from the point of view of the side playing it
+  int scoreMove(Position &position, int move, int maxDepth);
+
+  void clear();
+  uint64_t nodes() const;
+
+ private:
+  enum Bound { EXACT, LOWER, UPPER };
+  struct Entry {
+    uint64_t key;
+    int value;
+    int16_t depth;
+    int8_t bound;
+    int16_t move;  // in the key's frame, -1 if none
+  };
+
+  std::vector<Entry> m_table;
+  uint64_t m_mask;
+  uint64_t m_nodes;
+  // Set when a value depended on the depth limit somewhere below
+  bool m_hitLimit;
+
+  int negamax(Position &position, int depth, int alpha, int beta,
+              int *bestMove);
+  int deepen(Position &position, int maxDepth, int *bestMove);
+};
+
+template <class Position>
+AlphaBeta<Position>::AlphaBeta(unsigned int tableBits)
+    : m_table((size_t)1 << tableBits),
+      m_mask(((uint64_t)1 << tableBits) - 1),
+      m_nodes(0),
+      m_hitLimit(false) {
+  clear();
+}
+
+template <class Position>
+void AlphaBeta<Position>::clear() {
+  Entry empty = {~(uint64_t)0, 0, -1, EXACT, -1};
+  std::fill(m_table.begin(), m_table.end(), empty);
+}
+
+template <class Position>
+uint64_t AlphaBeta<Position>::nodes() const {
+  return m_nodes;
+}
+
+template <class Position>
+int AlphaBeta<Position>::search(Position &position, int maxDepth,
+                                int *bestMove) {
+  return deepen(position, maxDepth, bestMove);
+}
+
+template <class Position>
+int AlphaBeta<Position>::scoreMove(Position &position, int move,
+                                   int maxDepth) {
+  position.play(move);
+  int reply;
+  int value = -deepen(position, maxDepth - 1, &reply);
+  position.undo(move);
+  return value;
+}
+
+template <class Position>
+int AlphaBeta<Position>::deepen(Position &position, int maxDepth,
+                                int *bestMove) {
+  INSTRUMENT_TIMER(Minimax);
+  int value = 0;
+  *bestMove = -1;
+  for (int depth = 0; depth <= maxDepth; ++depth) {
+    m_hitLimit = false;
+    value = negamax(position, depth, -INFINITE_VALUE, INFINITE_VALUE,
+                    bestMove);
+    if (!m_hitLimit) {
+      break;
+    }
+  }
+  return value;
+}
+
+template <class Position>
+int AlphaBeta<Position>::negamax(Position &position, int depth, int alpha,
+                                 int beta, int *bestMove) {
+  ++m_nodes;
+  INSTRUMENT_COUNT(MinimaxNodes, 1);
+  *bestMove = -1;
+  int value;
+  if (position.terminal(&value)) {
+    return value;
+  }
+  if (depth <= 0) {
+    m_hitLimit = true;
+    return position.evaluate();
+  }
+
+  // A deep enough entry may settle the position outright; otherwise its
+  // move is tried first
+  int symmetry;
+  uint64_t key = position.key(&symmetry);
+  Entry &entry = m_table[key & m_mask];
+  int hashMove = -1;
+  if (entry.key == key) {
+    if (entry.move >= 0) {
+      hashMove = Position::unmapMove(entry.move, symmetry);
+    }
+    if (entry.depth >= depth) {
+      if (entry.bound == EXACT ||
+          (entry.bound == LOWER && entry.value >= beta) ||
+          (entry.bound == UPPER && entry.value <= alpha)) {
+        *bestMove = hashMove;
+        m_hitLimit |= (entry.depth != SOLVED);
+        return entry.value;
+      }
+    }
+  }
+
+  int moves[Position::MAX_MOVES];
+  int numMoves = position.moves(moves);
+  for (int i = 0; i < numMoves; ++i) {
+    if (moves[i] == hashMove) {
+      std::swap(moves[0], moves[i]);
+      break;
+    }
+  }
+
+  int originalAlpha = alpha;
+  int best = -INFINITE_VALUE;
+  bool outerHitLimit = m_hitLimit;
+  m_hitLimit = false;
+  for (int i = 0; i < numMoves; ++i) {
+    int reply;
+    position.play(moves[i]);
+    int childValue = -negamax(position, depth - 1, -beta, -alpha, &reply);
+    position.undo(moves[i]);
+    if (childValue > best) {
+      best = childValue;
+      *bestMove = moves[i];
+    }
+    alpha = std::max(alpha, childValue);
+    if (alpha >= beta) {
+      break;
+    }
+  }
+
+  // Always replace; entries from deeper iterations overwrite shallow ones
+  entry.key = key;
+  entry.value = best;
+  entry.depth = m_hitLimit ? (int16_t)depth : SOLVED;
+  entry.bound = (best <= originalAlpha) ? UPPER
+                : (best >= beta)        ? LOWER
+                                        : EXACT;
+  entry.move = (int16_t)((*bestMove >= 0)
+                             ? Position::mapMove(*bestMove, symmetry)
+                             : -1);
+  m_hitLimit |= outerHitLimit;
+  return best;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MappedFile.h"
+
+/* Checkpoint files hold a magic "TTTCHKPT", a version, the payload and an
+ * FNV-1a checksum of the payload. What the payload holds is up to the
+ * caller; Population writes its complete training state.
+ */
+
+/* Collects a snapshot of the payload in memory and hands it to a
+ * background thread, which adds the header and checksum and writes the
+ * file. The file is written under a temporary name and then renamed over
+ * the old one, so a run killed mid-write still leaves the previous
+ * checkpoint intact. commit() never waits: while a write is in flight the
+ * newest snapshot waits behind it and replaces any older one still
+ * waiting. The three buffers are swapped round, not reallocated.
+ */
+class CheckpointWriter {
+ public:
+  CheckpointWriter();
+  // Waits for the pending writes, then stops the writer thread
+  ~CheckpointWriter();
+
+  // Starts a new snapshot in the buffer
+  void begin();
+  void write(const void *data, size_t size);
+  template <class T>
+  void write(const T &value) {
+    write(&value, sizeof(T));
+  }
+
+  // Hands the snapshot to the writer thread, to be saved as 'path'
+  void commit(const std::string &path);
+  // Blocks until the last commit is on disk; false if it failed
+  bool wait();
+
+ private:
+  CheckpointWriter(const CheckpointWriter &other);
+  void operator=(const CheckpointWriter &right);
+
+  void run();
+  static bool writeFile(const std::string &path,
+                        const std::vector<unsigned char> &payload);
+
+  // Only touched by the caller
+  std::vector<unsigned char> m_buffer;
+  // Guarded by m_mutex
+  std::vector<unsigned char> m_pending;
+  std::string m_pendingPath;
+  bool m_hasPending;
+  bool m_busy;
+  bool m_stop;
+  bool m_succeeded;
+  // Only touched by the writer thread
+  std::vector<unsigned char> m_writing;
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::thread m_writer;
+};
+
+// Reads a checkpoint back from a read-only mapping of the file
+class CheckpointReader {
+ public:
+  CheckpointReader();
+
+  // Maps 'path' and checks its magic, version and checksum
+  bool open(const std::string &path);
+  // False once the payload runs out
+  bool read(void *data, size_t size);
+  template <class T>
+  bool read(T &value) {
+    return read(&value, sizeof(T));
+  }
+  // Points at 'size' bytes of the payload in place and skips them, or NULL
+  const unsigned char *skip(size_t size);
+
+ private:
+  CheckpointReader(const CheckpointReader &other);
+  void operator=(const CheckpointReader &right);
+
+  MappedFile m_file;
+  size_t m_position;
+  size_t m_end;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef FIXEDNN_H
+#define FIXEDNN_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <vector>
+using namespace Eigen;
+#include "NeuralNet.h"
+
+/* A network topology fixed at compile time, e.g. FixedNeuralNet<9, 18, 1>.
+ * The weights stay in the NeuralNet it is attached to, so breeding,
+ * mutation and save/load work unchanged. Only inference is replaced: every
+ * layer is viewed as a fixed-size matrix, letting Eigen unroll the products
+ * and keep each row's activations on the stack.
+ */
+template <int... Sizes>
+class FixedNeuralNet {
+  static_assert(sizeof...(Sizes) >= 2, "A network needs at least two layers");
+
+ public:
+  static bool matches(const std::vector<unsigned int> &layerSizes);
+  // Routes 'net' through the fixed kernel if its topology matches
+  static bool attach(NeuralNet &net);
+
+  static void forwardBatch(const double *parameters,
+                           const Ref<const MatrixXd> &inputs,
+                           Ref<MatrixXd> outputs);
+};
+
+// Rows pushed through the layers together; bounds the stack buffers
+const int FIXED_BATCH_ROWS = 16;
+
+// Forward pass through the layers In -> Out -> Rest... for up to
+// FIXED_BATCH_ROWS rows at a time
+template <int In, int Out, int... Rest>
+struct FixedLayers {
+  // Row-major keeps each row's activations contiguous; Eigen requires
+  // single-column matrices to be column-major
+  typedef Matrix<double, Dynamic, Out, (Out == 1) ? ColMajor : RowMajor,
+                 FIXED_BATCH_ROWS, Out>
+      Rows;
+
+  template <class Input>
+  static void forward(const double *parameters, const Input &input,
+                      Ref<MatrixXd> outputs) {
+    Map<const Matrix<double, In + 1, Out>> layer(parameters);
+    Rows next = input * layer.template topRows<In>();
+    next.rowwise() += layer.template bottomRows<1>();
+    next = (1.0 + (-next.array()).exp()).inverse().matrix();
+    FixedLayers<Out, Rest...>::forward(parameters + (In + 1) * Out, next,
+                                       outputs);
+  }
+};
+
+template <int In, int Out>
+struct FixedLayers<In, Out> {
+  template <class Input>
+  static void forward(const double *parameters, const Input &input,
+                      Ref<MatrixXd> outputs) {
+    Map<const Matrix<double, In + 1, Out>> layer(parameters);
+    outputs.noalias() = input * layer.template topRows<In>();
+    outputs.rowwise() += layer.template bottomRows<1>();
+    outputs = (1.0 + (-outputs.array()).exp()).inverse().matrix();
+  }
+};
+
+template <int... Sizes>
+bool FixedNeuralNet<Sizes...>::matches(
+    const std::vector<unsigned int> &layerSizes) {
+  const int sizes[] = {Sizes...};
+  if (layerSizes.size() != sizeof...(Sizes)) {
+    return false;
+  }
+  for (size_t i = 0; i < layerSizes.size(); ++i) {
+    if ((int)layerSizes[i] != sizes[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <int... Sizes>
+bool FixedNeuralNet<Sizes...>::attach(NeuralNet &net) {
+  if (!matches(net.getLayerSizes())) {
+    return false;
+  }
+  net.setKernel(&FixedNeuralNet<Sizes...>::forwardBatch);
+  return true;
+}
+
+template <int... Sizes>
+void FixedNeuralNet<Sizes...>::forwardBatch(
+    const double *parameters, const Ref<const MatrixXd> &inputs,
+    Ref<MatrixXd> outputs) {
+  for (Index row = 0; row < inputs.rows(); row += FIXED_BATCH_ROWS) {
+    Index numRows = std::min<Index>(FIXED_BATCH_ROWS, inputs.rows() - row);
+    FixedLayers<Sizes...>::forward(parameters,
+                                   inputs.middleRows(row, numRows),
+                                   outputs.middleRows(row, numRows));
+  }
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef GAMERESULT_H
+#define GAMERESULT_H
+
+// Outcome of one finished game. Games report this instead of writing into
+// Player::fitness so the caller decides when and where rewards are applied.
+struct GameResult {
+  double player1Reward;
+  double player2Reward;
+  int winner;  // 1 or 2 for the winning seat, 0 for a tie
+
+  GameResult() : player1Reward(0.0), player2Reward(0.0), winner(0) {}
+};
+
+#endif
@@ -2,21 +2,31 @@
 #define GENETIC_H
 
 #include <Eigen/Dense>
-#include <random>
 using namespace Eigen;
+#include "GenomeArena.h"
 #include "NeuralNet.h"
 #include "Player.h"
+#include "RandomStream.h"
+#include "Selection.h"
 
 class Genetic {
  public:
-  static void Breed(std::vector<Player *> *population, float greedyPercent);
+  // Randomness comes from the run seed's streams for 'generation', so the
+  // same seed gives the same children and mutations for the same population
+  // 'population' must be sorted by ascending fitness
+  static void Breed(std::vector<Player *> *population, GenomeArena *arena,
+                    Selection *selection, float greedyPercent,
+                    unsigned int generation);
   static void Mutate(std::vector<Player *> *population, float greedyPercent,
-                     float mutationRate);
+                     float mutationRate, unsigned int generation);
 
  private:
-  static std::vector<MatrixXd> crossOver(std::vector<MatrixXd> &parent1,
-                                         std::vector<MatrixXd> &parent2);
-  static NeuralPlayer *pickParent(std::vector<Player *> *population);
+  static void crossOver(const double *parent1, const double *parent2,
+                        double *child, size_t numParameters,
+                        RandomStream &random);
+  static NeuralPlayer *pickParent(std::vector<Player *> *population,
+                                  const Selection &selection,
+                                  RandomStream &random);
 };
 
 #endif
@@ -0,0 +1,41 @@
+#ifndef GENOMEARENA_H
+#define GENOMEARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/* One contiguous block holding the parameters of every network in a
+ * population, double-buffered. Networks bound to a slot read and mutate
+ * the front buffer while Genetic::Breed writes the next generation into
+ * the back buffer; swap() then makes it current without moving any data.
+ * Each genome starts on a 64-byte boundary.
+ */
+class GenomeArena {
+ public:
+  GenomeArena();
+
+  void reset(size_t numGenomes, size_t genomeSize);
+
+  double *front(size_t slot);
+  const double *front(size_t slot) const;
+  double *back(size_t slot);
+  void swap();
+
+  size_t numGenomes() const;
+  size_t genomeSize() const;
+
+  static const size_t ALIGNMENT = 64;
+
+ private:
+  GenomeArena(const GenomeArena &other);
+  void operator=(const GenomeArena &right);
+
+  std::vector<double> m_storage;
+  double *m_buffers[2];
+  int m_front;
+  size_t m_numGenomes;
+  size_t m_genomeSize;
+  size_t m_stride;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef HALLOFFAME_H
+#define HALLOFFAME_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Player.h"
+
+/* The best player of every generation. Only the latest 'capacity'
+ * champions keep their weights on the heap. Older ones are written to a
+ * spill file of raw parameter blocks, and their networks view the blocks
+ * through a read-only mapping of that file, so playing them pages the
+ * weights in without copying them back. The file grows by doubling and is
+ * only mapped again when it grows, so a spill costs O(1) amortised; blocks
+ * written in between show through the existing mapping. A capacity of 0
+ * keeps everything in memory. The spill file is scratch space and is
+ * removed again.
+ */
+class HallOfFame {
+ public:
+  HallOfFame();
+  ~HallOfFame();
+
+  void setCapacity(size_t capacity, const std::string &spillPath);
+  // Returns false if a spill failed; the champion then stays in memory
+  bool add(const NeuralPlayer &champion);
+  void clear();
+
+  size_t size() const;
+  size_t numSpilled() const;
+  // Champion 'i', oldest first; owned by the hall of fame
+  Player *operator[](size_t i) const;
+
+ private:
+  HallOfFame(const HallOfFame &other);
+  void operator=(const HallOfFame &right);
+
+  bool spillOldest();
+  bool growSpillFile(size_t blockSize);
+
+  std::vector<NeuralPlayer *> m_champions;
+  // The first m_numSpilled champions view the spill file
+  size_t m_numSpilled;
+  size_t m_capacity;
+  std::string m_spillPath;
+  std::FILE *m_spillFile;
+  // Blocks the spill file and its mapping have room for
+  size_t m_spillBlocks;
+  MappedFile *m_mapping;
+};
+
+#endif
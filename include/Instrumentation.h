@@ -0,0 +1,89 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/* Hot-path counters and scoped timers, for finding where a slow run spends
+ * its time. Build with TTT_INSTRUMENT defined, as the Debug configurations
+ * do, to turn them on. Without it the macros below expand to nothing, so a
+ * release build pays nothing for them.
+ *
+ *   INSTRUMENT_COUNT(MovesPlayed, 1);  // adds to a Counter
+ *   INSTRUMENT_TIMER(Forward);         // times the rest of the scope
+ *   INSTRUMENT_REPORT(std::cout);      // totals over all threads
+ *
+ * The counts live in ThreadCounters slots, so counting never contends.
+ * Timers are inclusive: a forward pass made during a turn counts towards
+ * both Forward and TakeTurn.
+ *
+ * The report's forward rows are the always-on count behind
+ * NeuralNet::forwardPasses() and the metrics log's forward_passes, one per
+ * board scored. The Forward timer's calls are forwardBatch calls, each of
+ * which scores a batch of rows.
+ */
+enum class Counter {
+  MovesPlayed,       // moves made in any game
+  GamesCompleted,    // games played to a win or tie
+  BreedAllocations,  // buffers Genetic::Breed had to grow
+  MinimaxNodes,      // nodes visited by AlphaBeta
+  NumCounters
+};
+
+enum class Timer {
+  Forward,    // NeuralNet::forwardBatch
+  TakeTurn,   // a player scoring and making a move
+  Minimax,    // AlphaBeta searches
+  CrossOver,  // Genetic::crossOver
+  NumTimers
+};
+
+#if defined(TTT_INSTRUMENT)
+
+class Instrumentation {
+ public:
+  static void count(Counter counter, uint64_t amount);
+  static void addTime(Timer timer, std::chrono::steady_clock::duration time);
+
+  // Totals over all threads, running and finished
+  static uint64_t total(Counter counter);
+  static void report(std::ostream &os);
+  static void reset();
+};
+
+// Adds the time until the end of its scope to 'timer'
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Timer timer)
+      : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    Instrumentation::addTime(m_timer,
+                             std::chrono::steady_clock::now() - m_start);
+  }
+
+ private:
+  ScopedTimer(const ScopedTimer &other);
+  void operator=(const ScopedTimer &right);
+
+  Timer m_timer;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+#define INSTRUMENT_CONCAT2(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT2(a, b)
+#define INSTRUMENT_COUNT(counter, amount) \
+  Instrumentation::count(Counter::counter, (amount))
+#define INSTRUMENT_TIMER(timer) \
+  ScopedTimer INSTRUMENT_CONCAT(scopedTimer, __LINE__)(Timer::timer)
+#define INSTRUMENT_REPORT(os) Instrumentation::report(os)
+
+#else
+
+#define INSTRUMENT_COUNT(counter, amount) ((void)0)
+#define INSTRUMENT_TIMER(timer) ((void)0)
+#define INSTRUMENT_REPORT(os) ((void)0)
+
+#endif
+
+#endif
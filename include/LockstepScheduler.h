@@ -0,0 +1,105 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <utility>
+#include <vector>
+using namespace Eigen;
+#include "Player.h"
+
+/* Plays many games side by side. Each game runs until its player to move
+ * needs a network evaluation and is then suspended. Once every game is
+ * waiting, the boards pending for the same NeuralPlayer are stacked into
+ * one matrix and scored with a single forward pass, after which every game
+ * resumes. Game must provide the resumable interface of TicTacToe.
+ */
+template <class Game>
+class LockstepScheduler {
+ public:
+  LockstepScheduler();
+
+  // Queues a game to be played. The scheduler does not own it.
+  void add(Game *game);
+  // Plays every queued game to completion and clears the queue
+  void run();
+
+ private:
+  std::vector<Game *> m_games;
+  std::vector<std::pair<const NeuralPlayer *, size_t>> m_waiting;
+  // (first game, offset into m_waiting) for each group of m_waiting
+  std::vector<std::pair<size_t, size_t>> m_groups;
+  std::vector<Index> m_firstRow;
+  MatrixXd m_boards;
+};
+
+template <class Game>
+LockstepScheduler<Game>::LockstepScheduler() {}
+
+template <class Game>
+void LockstepScheduler<Game>::add(Game *game) {
+  m_games.push_back(game);
+}
+
+template <class Game>
+void LockstepScheduler<Game>::run() {
+  for (size_t i = 0; i < m_games.size(); ++i) {
+    m_games[i]->start();
+  }
+
+  while (true) {
+    // Group the suspended games by the player they are waiting on
+    m_waiting.clear();
+    for (size_t i = 0; i < m_games.size(); ++i) {
+      if (!m_games[i]->isFinished()) {
+        m_waiting.push_back(std::make_pair(m_games[i]->pendingPlayer(), i));
+      }
+    }
+    if (m_waiting.empty()) {
+      break;
+    }
+    std::sort(m_waiting.begin(), m_waiting.end());
+
+    // Serve groups in order of their first game so that players shared
+    // between groups, such as a RandomPlayer, always see the same sequence
+    m_groups.clear();
+    for (size_t i = 0; i < m_waiting.size(); ++i) {
+      if (i == 0 || m_waiting[i].first != m_waiting[i - 1].first) {
+        m_groups.push_back(std::make_pair(m_waiting[i].second, i));
+      }
+    }
+    std::sort(m_groups.begin(), m_groups.end());
+
+    for (size_t g = 0; g < m_groups.size(); ++g) {
+      size_t groupStart = m_groups[g].second;
+      const NeuralPlayer *player = m_waiting[groupStart].first;
+      size_t groupEnd = groupStart;
+      while (groupEnd < m_waiting.size() &&
+             m_waiting[groupEnd].first == player) {
+        ++groupEnd;
+      }
+
+      // Stack every pending board of this player and score them at once
+      size_t groupSize = groupEnd - groupStart;
+      m_boards.resize(groupSize * Game::NUM_ACTIONS, Game::NUM_PERCEPTS);
+      m_firstRow.resize(groupSize + 1);
+      Index numRows = 0;
+      for (size_t k = 0; k < groupSize; ++k) {
+        m_firstRow[k] = numRows;
+        Game *game = m_games[m_waiting[groupStart + k].second];
+        numRows += game->pendingBoards(m_boards, numRows);
+      }
+      m_firstRow[groupSize] = numRows;
+
+      NeuralNet::ConstBatch scores =
+          player->getMoves(m_boards.topRows(numRows));
+      for (size_t k = 0; k < groupSize; ++k) {
+        Game *game = m_games[m_waiting[groupStart + k].second];
+        game->resume(scores.data() + m_firstRow[k]);
+      }
+    }
+  }
+  m_games.clear();
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef MCTSPLAYER_H
+#define MCTSPLAYER_H
+
+#include <Eigen/Dense>
+#include <mutex>
+using namespace Eigen;
+#include "MonteCarloTree.h"
+#include "Player.h"
+
+class ThreadPool;
+
+/* A player that runs Monte Carlo tree search, on UltimateTTT only. With
+ * several threads each searches its own tree from the root and the visits
+ * are summed; a player searches one move at a time, so on a shared player
+ * concurrent moves take turns. Trees are kept per thread and reused.
+ */
+class MCTSPlayer : public Player {
+ public:
+  MCTSPlayer(const MCTSSettings &settings);
+  MCTSPlayer(const MCTSPlayer &other);
+  virtual ~MCTSPlayer();
+
+  void operator=(const MCTSPlayer &right);
+
+  const MCTSSettings &getSettings() const;
+
+  // Each legal move is scored by its visits at the root. getMove() takes
+  // an UltimateTTT board from the mover's view, see toPlayerPerspective.
+  using Player::scoreMoves;
+  virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const UltimateTTT &game, const uint64_t *legalMoves,
+                          double *scores) const override;
+
+ private:
+  MCTSSettings m_settings;
+  ThreadPool *m_pool;  // NULL for a single tree
+  mutable std::mutex m_poolMutex;
+
+  // Adds the root visits of each action to 'scores'
+  void search(const UltimateTTTPosition &root, double *scores) const;
+};
+
+#endif
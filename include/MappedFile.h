@@ -0,0 +1,39 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+/* A whole file mapped read-only into memory, with mmap on POSIX systems
+ * and a file mapping on Windows. The contents are paged in as they are
+ * read; nothing is copied onto the heap. Pointers into the mapping stay
+ * valid until the next open() or close().
+ */
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Maps all of 'path', replacing any earlier mapping. Returns false, and
+  // leaves nothing mapped, if the file cannot be opened or is empty.
+  bool open(const std::string &path);
+  void close();
+
+  const unsigned char *data() const;
+  size_t size() const;
+
+ private:
+  MappedFile(const MappedFile &other);
+  void operator=(const MappedFile &right);
+
+  const unsigned char *m_data;
+  size_t m_size;
+#if defined(_WIN32)
+  void *m_file;
+  void *m_mapping;
+#else
+  int m_fd;
+#endif
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef METRICSLOG_H
+#define METRICSLOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Layout of a metrics file: one JSON object per line, or CSV with a header
+enum class MetricsFormat { JsonLines, Csv };
+
+// What one training generation did and how long each phase took
+struct GenerationMetrics {
+  unsigned int epoch;  // generation counted across stages
+  int stage;           // 1 to 3
+  int generation;      // within the stage
+  // Wall time per phase, in seconds; 0 for phases the stage skips
+  double playGamesSeconds;
+  double roundRobinSeconds;
+  double sortSeconds;
+  double hallOfFameSeconds;
+  double breedSeconds;
+  double mutateSeconds;
+  double totalSeconds;
+  uint64_t games;
+  uint64_t forwardPasses;
+  double gamesPerSecond;
+  double minFitness;
+  double medianFitness;
+  double maxFitness;
+  int hallOfFameGames;
+  double winPercent;
+  double lossPercent;
+  double tiePercent;
+};
+
+/* Writes a record per generation to a file. write() only formats the
+ * record and appends it to a buffer; a background thread takes the buffer
+ * and writes it out, so a slow disk never holds up training. close(), or
+ * the destructor, writes whatever is left.
+ */
+class MetricsLog {
+ public:
+  MetricsLog();
+  ~MetricsLog();
+
+  // Starts a new file at 'path', closing any earlier one
+  bool open(const std::string &path, MetricsFormat format);
+  void close();
+  bool isOpen() const;
+
+  void write(const GenerationMetrics &metrics);
+
+ private:
+  MetricsLog(const MetricsLog &other);
+  void operator=(const MetricsLog &right);
+
+  void writerLoop();
+
+  std::FILE *m_file;
+  MetricsFormat m_format;
+  std::thread m_writer;
+  std::mutex m_mutex;
+  std::condition_variable m_ready;
+  // Formatted records not yet handed to the writer thread
+  std::string m_pending;
+  bool m_stopping;
+};
+
+#endif
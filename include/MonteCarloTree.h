@@ -0,0 +1,96 @@
+#ifndef MONTECARLOTREE_H
+#define MONTECARLOTREE_H
+
+#include <Eigen/Dense>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace Eigen;
+#include "NeuralNet.h"
+#include "RandomStream.h"
+
+class UltimateTTTPosition;
+
+// How MCTSPlayer searches; the defaults are plain UCT with random playouts
+struct MCTSSettings {
+  // Playouts per move, shared between the trees. 0 leaves only the time
+  // limit, and both 0 falls back to the default playouts.
+  unsigned int playouts;
+  // Wall-clock budget per move, 0 for none
+  double seconds;
+  // Independent trees searched in parallel from the root
+  unsigned int threads;
+  // Weight of the exploration term in the selection rule
+  double exploration;
+  // Scores the after-move boards of each expanded node, as NeuralPlayer
+  // does. The scores become move priors, see priorTemperature.
+  const NeuralNet *network;
+  // Score new leaves with the network instead of a random playout
+  bool networkValue;
+  // Softmax temperature turning network scores into priors
+  double priorTemperature;
+  // Nodes per tree; once full, leaves are no longer expanded
+  size_t maxNodes;
+
+  MCTSSettings()
+      : playouts(10000),
+        seconds(0.0),
+        threads(1),
+        exploration(1.4),
+        network(NULL),
+        networkValue(false),
+        priorTemperature(0.1),
+        maxNodes((size_t)1 << 20) {}
+};
+
+/* One Monte Carlo search tree over UltimateTTTPosition. Every iteration
+ * selects a path by UCT (PUCT once the network supplies priors), expands
+ * the leaf and scores it with a random playout or the network, then backs
+ * the result up the path. Nodes live in one vector that is cleared, not
+ * freed, between searches, so a tree kept per thread stops allocating once
+ * it has grown to its working size.
+ */
+class MonteCarloTree {
+ public:
+  MonteCarloTree();
+
+  /* Runs up to 'playouts' iterations from 'root', or until 'deadline' when
+   * 'timed' is set, and adds the visits of each root move to 'visits',
+   * indexed by action. Returns the number of iterations run.
+   */
+  unsigned int search(const UltimateTTTPosition &root,
+                      const MCTSSettings &settings, unsigned int playouts,
+                      bool timed,
+                      std::chrono::steady_clock::time_point deadline,
+                      RandomStream &random, double *visits);
+
+  size_t numNodes() const;
+
+ private:
+  MonteCarloTree(const MonteCarloTree &other);
+  void operator=(const MonteCarloTree &right);
+
+  struct Node {
+    int32_t firstChild;  // -1 until expanded
+    uint32_t visits;
+    // Results summed for the side that played 'action' to reach this node,
+    // +1 per win and -1 per loss
+    float value;
+    float prior;
+    float networkValue;  // same view as 'value'
+    uint8_t action;
+    uint8_t numChildren;
+  };
+
+  std::vector<Node> m_nodes;
+  MatrixXd m_boards;
+
+  bool expand(int node, const UltimateTTTPosition &position,
+              const MCTSSettings &settings);
+  int selectChild(int node, const MCTSSettings &settings) const;
+  // Result of random moves to the end: 1 if X wins, -1 if O wins, else 0
+  static int playout(UltimateTTTPosition position, RandomStream &random);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MOVESELECTION_H
+#define MOVESELECTION_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RandomStream.h"
+
+/* Picks an action from a row of scores without sorting or allocating.
+ * Bit i of 'legal' (word i / 64, bit i % 64) is set if action i may be
+ * played; other scores are ignored. Builds with AVX2 enabled (__AVX2__)
+ * compare four scores per instruction, which pays off on the 81-wide
+ * UltimateTTT rows; other builds give the same answers one score at a time.
+ */
+class MoveSelection {
+ public:
+  /* Highest scored legal action, ties going to the higher index. NaN
+   * scores are skipped; if no legal score is left to compare, the last
+   * legal action is played. At least one action must be legal.
+   */
+  static int argmax(const double *scores, const uint64_t *legal,
+                    size_t count);
+  /* Draws a legal action with probability proportional to
+   * e^(score / temperature). A temperature of 0 or less plays argmax.
+   */
+  static int sample(const double *scores, const uint64_t *legal,
+                    size_t count, double temperature, RandomStream &random);
+
+  static bool usesAvx2();
+};
+
+#endif
@@ -2,38 +2,135 @@
 #define NN_H
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 using namespace Eigen;
+#include "GenomeArena.h"
+#include "MappedFile.h"
+#include "RandomStream.h"
 
 enum Activations { sigmoid, relu, softmax };
 
+// Arithmetic used for inference. Weights are always stored as doubles.
+enum class Precision { Double, Float };
+
+/* Model files. Text is the original format: the layer count, the layer
+ * sizes and every parameter as decimal text, ending in 'D'. Binary starts
+ * with a 64-byte header (magic "TTTMODEL", version, data type, layer count,
+ * header size, parameter count and a checksum of the sizes and weights),
+ * then the layer sizes as uint32, padded so the raw doubles that follow
+ * start on a 64-byte boundary. Both use the host's byte order.
+ */
+enum class ModelFormat { Text, Binary };
+
+/* The weights of all layers are one flat block of parameters. Layer 'lay'
+ * is a column-major (inputs + 1) x outputs matrix whose last row is the
+ * bias. The block is either owned by the network, a slot of a GenomeArena
+ * shared with the rest of the population once bound, or read-only memory
+ * such as a mapped file once viewed. Copies are always owned.
+ */
 class NeuralNet {
  public:
+  // Per-layer outputs reused between calls. The buffers only grow, so once
+  // sized for the largest batch, inference does not allocate.
+  typedef Matrix<float, Dynamic, Dynamic, RowMajor> RowMatrixXf;
+  struct Workspace {
+    std::vector<MatrixXd> layers;
+    // Single-precision path; row-major so a batch is one contiguous block
+    RowMatrixXf floatInput;
+    std::vector<RowMatrixXf> floatLayers;
+  };
+  typedef Block<const MatrixXd> ConstBatch;
+  typedef Block<const MatrixXd, 1, Dynamic> ConstRow;
+  // Replacement for the dynamic forward pass, e.g. FixedNeuralNet's.
+  // Writes one output row per input row into 'outputs'.
+  typedef void (*BatchKernel)(const double *parameters,
+                              const Ref<const MatrixXd> &inputs,
+                              Ref<MatrixXd> outputs);
+
   NeuralNet();
-  NeuralNet(const std::vector<unsigned int> &layerSizes);
+  NeuralNet(const std::vector<unsigned int> &layerSizes, RandomStream &random);
   NeuralNet(const NeuralNet &nn);
+  ~NeuralNet();
+
+  // One row as a batch of one, in this thread's workspace
+  ConstRow forward(
+      const Ref<const RowVectorXd, 0, InnerStride<>> &input) const;
+  MatrixXd forwardBatch(const MatrixXd &inputs) const;
+  ConstBatch forwardBatch(const Ref<const MatrixXd> &inputs,
+                          Workspace &workspace) const;
+
+  static Workspace &threadWorkspace();
+  // Rows scored by forwardBatch on all threads so far, one per board
+  static uint64_t forwardPasses();
 
-  RowVectorXd forward(const RowVectorXd &input) const;
+  const std::vector<unsigned int> &getLayerSizes() const;
+  void setKernel(BatchKernel kernel);
+  void setPrecision(Precision precision);
+  static bool attach(NeuralNet &net);
 
   void printWeights() const;
 
   void operator=(const NeuralNet &nn);
 
-  std::vector<MatrixXd> &getWeights();
-  void setWeights(const std::vector<MatrixXd> &weights);
+  // Moves the parameters into 'slot' of 'arena'
+  void bind(GenomeArena *arena, size_t slot);
+  // The arena slot the next generation is written to, NULL if unbound
+  double *nextParameters();
+  // Reads the weights from 'parameters' from now on, without copying them.
+  // The memory must outlive the view and the network is read-only.
+  void view(const double *parameters);
 
-  bool saveToFile(std::string fileName) const;
+  size_t numParameters() const;
+  double *parameters();
+  const double *parameters() const;
+  unsigned int numLayers() const;
+  Map<const MatrixXd> layer(unsigned int lay) const;
+
+  bool saveToFile(std::string fileName,
+                  ModelFormat format = ModelFormat::Binary) const;
+  // Reads either format into the network's own storage
   bool loadFromFile(std::string fileName);
+  // Maps a binary model and views its weights in place; read-only
+  bool mapFromFile(std::string fileName);
 
  private:
   std::vector<unsigned int> m_layerSizes;
-  std::vector<MatrixXd> m_weights;
+  // Start of each layer in the parameter block, plus the total size
+  std::vector<size_t> m_layerOffsets;
+  VectorXd m_ownedParameters;
+  GenomeArena *m_arena;
+  size_t m_slot;
+  const double *m_view;
+  // Owned mapping behind m_view after mapFromFile(), else NULL
+  MappedFile *m_mapping;
+  BatchKernel m_kernel;
+
+  // Float copy of the parameters, rebuilt by setPrecision(). Marked stale
+  // whenever the weights may have changed; stale copies are not used.
+  Precision m_precision;
+  VectorXf m_floatParameters;
+  bool m_floatStale;
+
+  void setLayerSizes(const std::vector<unsigned int> &layerSizes);
+  void releaseMapping();
+  bool loadText(std::ifstream &inputFile);
+  // Checks a binary model and returns its weights, or NULL
+  const double *parseBinary(const unsigned char *data, size_t size,
+                            std::vector<unsigned int> &layerSizes) const;
+
+  ConstBatch forwardBatchFloat(const Ref<const MatrixXd> &inputs,
+                               Workspace &workspace) const;
 
   inline RowVectorXd applyNonlinearity(const RowVectorXd &input,
                                        Activations activation) const;
+  inline void applyNonlinearityRows(Ref<MatrixXd> rows,
+                                    Activations activation) const;
+  inline void applyNonlinearityRows(float *rows, Index numRows, Index rowSize,
+                                    Activations activation) const;
   static inline double relu(double x);
   static inline double sigmoid(double x);
 };
@@ -0,0 +1,35 @@
+#ifndef PERFECTPLAYTABLE_H
+#define PERFECTPLAYTABLE_H
+
+#include <cstdint>
+
+/* Minimax solution of every reachable TicTacToe position, built once on
+ * first use. A board is indexed in base 3, square 0 most significant, with
+ * each square 0 (empty), 1 (X) or 2 (O), matching States. Values are from
+ * X's point of view: 10 - (pieces on the board) once X has won, the
+ * negative of that once O has, and 0 for a draw, so a faster win scores
+ * higher. Unreachable boards hold 0 and no moves.
+ */
+class PerfectPlayTable {
+ public:
+  static const int NUM_STATES = 19683;  // 3^9
+
+  // Value of the board with base-3 index 'state'
+  static int value(int state);
+  // Bit i is set if playing square i achieves the value for the side to move
+  static uint16_t bestMoves(int state);
+  // Added to a board's index when 'player' (1 = X, 2 = O) takes 'square'
+  static int moveOffset(int square, int player);
+
+ private:
+  PerfectPlayTable();
+  static const PerfectPlayTable &instance();
+
+  int solve(int state, int cells[9], int pieces);
+
+  int8_t m_values[NUM_STATES];
+  uint16_t m_bestMoves[NUM_STATES];
+  bool m_solved[NUM_STATES];
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+ * numbers: as easy as 1, 2, 3"). Each 128-bit counter maps to four random
+ * words through a keyed bijection, so any block of any stream can be
+ * generated independently: no state is shared between threads and the
+ * result does not depend on the order blocks are produced in.
+ */
+class Philox {
+ public:
+  Philox(uint64_t seed);
+
+  // Random words for block 'index' of 'stream'
+  void block(uint64_t stream, uint64_t index, uint32_t out[4]) const;
+
+  /* Adds N(0, stddev^2) noise to 'count' values using blocks firstBlock..
+   * of 'stream', two values per block via Box-Muller. Builds with AVX2
+   * enabled (__AVX2__) generate four blocks per iteration; other builds
+   * produce the same values, up to rounding, one block at a time.
+   */
+  void addNormal(double *values, size_t count, double stddev,
+                 uint64_t stream, uint64_t firstBlock = 0) const;
+
+ private:
+  uint32_t m_key[2];
+};
+
+#endif
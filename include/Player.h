@@ -5,6 +5,11 @@
 #include <vector>
 using namespace Eigen;
 #include "NeuralNet.h"
+#include "RandomStream.h"
+
+class NeuralPlayer;
+class TicTacToe;
+class UltimateTTT;
 
 class Player {
  public:
@@ -21,6 +26,19 @@ class Player {
 
   virtual RowVectorXd getMove(const RowVectorXd &input) const = 0;
 
+  /* Writes a score per square of 'game' for the side to move into
+   * 'scores'; the highest scored legal square is played. Bit i of
+   * 'legalMoves' is set if square i is free, other scores are ignored.
+   * By default the squares are scored by getMove().
+   */
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const;
+  // As above for the 81 actions of 'game', see UltimateTTT::legalMoves
+  virtual void scoreMoves(const UltimateTTT &game, const uint64_t *legalMoves,
+                          double *scores) const;
+  // Non-NULL for players whose scoring can be batched across games
+  virtual const NeuralPlayer *asNeural() const;
+
   static bool ComparePlayer(const Player *left, const Player *right);
   static void Swap(Player *left, Player *right);
 };
@@ -29,7 +47,8 @@ class Player {
 class NeuralPlayer : public Player {
  public:
   NeuralPlayer();
-  NeuralPlayer(const std::vector<unsigned int> &layerSizes);
+  NeuralPlayer(const std::vector<unsigned int> &layerSizes,
+               RandomStream &random);
   NeuralPlayer(const NeuralPlayer &other);
   virtual ~NeuralPlayer();
 
@@ -37,6 +56,14 @@ class NeuralPlayer : public Player {
   NeuralNet neural;
 
   virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const override;
+  virtual void scoreMoves(const UltimateTTT &game, const uint64_t *legalMoves,
+                          double *scores) const override;
+  virtual const NeuralPlayer *asNeural() const override;
+  // Scores each row of 'inputs' in a single batched pass. The result lives
+  // in this thread's NeuralNet workspace until the next call.
+  NeuralNet::ConstBatch getMoves(const Ref<const MatrixXd> &inputs) const;
 };
 
 // A player with a manual input brain
@@ -49,6 +76,10 @@ class ManualPlayer : public Player {
   void operator=(const ManualPlayer &right);
 
   virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const override;
+  virtual void scoreMoves(const UltimateTTT &game, const uint64_t *legalMoves,
+                          double *scores) const override;
 
  private:
   std::istream &m_is;
@@ -56,19 +87,50 @@ class ManualPlayer : public Player {
   const int m_numActions;
 };
 
-// A player with a random input brain
+// A player with a random input brain. Each instance draws from its own
+// stream so several can play on different threads at once.
 class RandomPlayer : public Player {
  public:
   RandomPlayer(const int _size);
+  RandomPlayer(const int _size, const RandomStream &random);
   RandomPlayer(const RandomPlayer &other);
   virtual ~RandomPlayer();
 
   void operator=(const RandomPlayer &right);
 
+  // Continues from the start of 'random' instead
+  void reseed(const RandomStream &random);
+
   virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const override;
+  virtual void scoreMoves(const UltimateTTT &game, const uint64_t *legalMoves,
+                          double *scores) const override;
 
  private:
   const int size;
+  mutable RandomStream m_random;
+};
+
+// A player that searches the game tree, at most 'depth' plies ahead
+class SearchPlayer : public Player {
+ public:
+  SearchPlayer(const int depth);
+  SearchPlayer(const SearchPlayer &other);
+  virtual ~SearchPlayer();
+
+  void operator=(const SearchPlayer &right);
+
+  int getDepth() const;
+
+  // Only scoreMoves() searches, and only TicTacToe; this scores nothing
+  using Player::scoreMoves;
+  virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const override;
+
+ private:
+  int m_depth;
 };
 
 // A player with a theoretically perfect brain
@@ -80,7 +142,14 @@ class PerfectPlayer : public Player {
 
   void operator=(const PerfectPlayer &right);
 
+  // The solved table only covers TicTacToe
+  using Player::scoreMoves;
   virtual RowVectorXd getMove(const RowVectorXd &input) const override;
+  virtual void scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                          double *scores) const override;
+
+ private:
+  mutable RandomStream m_random;
 };
 
 #endif
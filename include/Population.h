@@ -3,37 +3,126 @@
 #define POPULATION_H
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 using namespace Eigen;
+#include "Checkpoint.h"
+#include "FixedNeuralNet.h"
+#include "GameResult.h"
 #include "Genetic.h"
+#include "HallOfFame.h"
+#include "Instrumentation.h"
+#include "LockstepScheduler.h"
+#include "MCTSPlayer.h"
+#include "MetricsLog.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
 
+// Results of the best player's hall of fame games, from its side
 struct Statistics {
+  int games;
   double winPercent;
   double lossPercent;
   double tiePercent;
+  // 95% Wilson score intervals, in percent
+  double winLow, winHigh;
+  double lossLow, lossHigh;
+  double tieLow, tieHigh;
+};
+
+// How playGames and roundRobin drive their games
+enum class EvaluationMode {
+  Direct,   // each game runs to completion on its own
+  Lockstep  // games are interleaved and network calls batched across them
 };
 
 class Population {
  public:
   Population();
   ~Population();
-  void Init(int numActions, std::istream &is = std::cin,
+  void Init(int numPercepts, std::istream &is = std::cin,
             std::ostream &os = std::cout);
+  // Instead of Init, continues the run saved in a checkpoint
+  bool Resume(const std::string &path, std::istream &is = std::cin,
+              std::ostream &os = std::cout);
+  void SetEvaluationMode(EvaluationMode mode);
+  void SetPrecision(Precision precision);
+  void SetSelection(SelectionMethod method, unsigned int tournamentSize = 3);
+  void SetMCTSOpponent(const MCTSSettings &settings);
+  void SetHallOfFameSampling(unsigned int recent, unsigned int older);
+  void SetHallOfFameCapacity(size_t capacity,
+                             const std::string &spillPath = "");
+  void SetCheckpoint(const std::string &path, unsigned int interval);
+  bool SetMetricsLog(const std::string &path,
+                     MetricsFormat format = MetricsFormat::JsonLines);
+  void SetTrace(const std::string &path, size_t eventsPerThread = 1 << 16);
   bool SaveBestPlayer(std::string path);
   Player *LoadPlayerFromFile(std::string path);
 
-  template <class Game>
+  // Net picks the inference topology at compile time: NeuralNet for any
+  // topology, or a FixedNeuralNet matching the layer sizes chosen at Init
+  template <class Game, class Net = NeuralNet>
   double Train(bool verbose);
 
   template <class Game>
   void PlayBest();
+  template <class Game>
+  Statistics Benchmark(Player *opponent);
 
  private:
+  enum class TrainingStage { PlayRandom, RoundRobin, Both };
+
   int m_populationSize;
   int m_iterations;
   int m_gamesToSimulate;
+  unsigned int m_numThreads;
+  ThreadPool *m_pool;
+  EvaluationMode m_evaluationMode;
+  Precision m_precision;
+  // Weights of every player in m_population, see GenomeArena
+  GenomeArena m_arena;
+  Selection m_selection;
+  // Hall of fame opponents per generation, see SetHallOfFameSampling
+  unsigned int m_hofRecent;
+  unsigned int m_hofOlder;
+  // Replaces the RandomPlayer in playGames if set, see SetMCTSOpponent
+  MCTSPlayer *m_searchOpponent;
   std::vector<Player *> m_population;
-  std::vector<Player *> m_hallOfFame;
+  HallOfFame m_hallOfFame;
+  // See SetHallOfFameCapacity; an empty m_spillPath is derived per run
+  size_t m_hofCapacity;
+  std::string m_spillPath;
+
+  // Where training stands, kept between generations for checkpoints
+  TrainingStage m_stage;
+  int m_generation;
+  // Counts generations across all stages; selects the random streams
+  unsigned int m_epoch;
+  float m_greedyPercent;
+  float m_mutationRate;
+
+  std::string m_checkpointPath;
+  unsigned int m_checkpointInterval;
+  // Champions restored by Resume that Train has not attached yet
+  size_t m_restoredChampions;
+  CheckpointWriter m_checkpointWriter;
+
+  MetricsLog m_metrics;
+  // Games played by every phase so far, for the metrics
+  uint64_t m_gamesPlayed;
+
+  // Timeline of Train, see SetTrace; no trace if the path is empty
+  std::string m_tracePath;
+  size_t m_traceEvents;
+
+  void initThreads(std::istream &is, std::ostream &os);
+  void createPlayers(const std::vector<unsigned int> &layerSizes);
+  void saveCheckpoint();
+  int stageNumber() const;
+  // Seconds since 'start', which then moves on to now
+  static double lapSeconds(std::chrono::steady_clock::time_point &start);
 
   template <class Game>
   void playTestGame(Player *loadedPlayer);
@@ -42,10 +131,22 @@ class Population {
   void roundRobin();
 
   template <class Game>
-  void playGames(Player *opponent);
+  void playGames(unsigned int generation);
+
+  template <class Game>
+  void playGamesLockstep(size_t begin, size_t end, RandomPlayer *opponents,
+                         int numPairs, unsigned int generation);
 
   template <class Game>
-  Statistics playHallOfFame(Player *player);
+  Statistics playHallOfFame(Player *player, unsigned int generation);
+  std::string spillPath(const std::string &checkpointPath) const;
+  void addChampion(const NeuralPlayer &champion);
+  void sampleHallOfFame(size_t numChampions, unsigned int generation,
+                        std::vector<size_t> &sample) const;
+  // Outcomes for a player that moves second in the even games
+  static Statistics tally(const std::vector<GameResult> &results);
+
+  void preparePrecision();
 
   void printSummary(const int generation, Statistics stats) const;
   void printPopulationFrom(const unsigned int start,
@@ -55,20 +156,39 @@ class Population {
 //--------------------------------FUNCTIONS--------------------------------
 
 Population::Population()
-    : m_populationSize(0), m_iterations(0), m_gamesToSimulate(0) {}
+    : m_populationSize(0),
+      m_iterations(0),
+      m_gamesToSimulate(0),
+      m_numThreads(1),
+      m_pool(NULL),
+      m_evaluationMode(EvaluationMode::Direct),
+      m_precision(Precision::Double),
+      m_hofRecent(0),
+      m_hofOlder(0),
+      m_searchOpponent(NULL),
+      m_hofCapacity(0),
+      m_stage(TrainingStage::PlayRandom),
+      m_generation(0),
+      m_epoch(0),
+      m_greedyPercent(0.02f),
+      m_mutationRate(0.05f),
+      m_checkpointInterval(0),
+      m_restoredChampions(0),
+      m_gamesPlayed(0),
+      m_traceEvents(0) {}
 
 Population::~Population() {
+  delete m_pool;
+  m_pool = NULL;
+  delete m_searchOpponent;
+  m_searchOpponent = NULL;
   for (unsigned int i = 0; i < m_population.size(); ++i) {
     delete m_population[i];
     m_population[i] = NULL;
   }
-  for (unsigned int i = 0; i < m_hallOfFame.size(); ++i) {
-    delete m_hallOfFame[i];
-    m_hallOfFame[i] = NULL;
-  }
 }
 
-void Population::Init(int numActions, std::istream &is, std::ostream &os) {
+void Population::Init(int numPercepts, std::istream &is, std::ostream &os) {
   // Get population size
   os << "Population size: ";
   is >> m_populationSize;
@@ -108,7 +228,7 @@ void Population::Init(int numActions, std::istream &is, std::ostream &os) {
 
   // Populate m_layerSizes
   std::vector<unsigned int> m_layerSizes;
-  m_layerSizes.push_back(numActions);
+  m_layerSizes.push_back(numPercepts);
   for (int i = 0; i < hiddenLayers; ++i) {
     os << "Number in hidden layer " << i + 1 << ": ";
     unsigned int layerSize;
@@ -122,75 +242,294 @@ void Population::Init(int numActions, std::istream &is, std::ostream &os) {
   }
   m_layerSizes.push_back(1);
 
-  // Instantiate the Players
+  initThreads(is, os);
+  createPlayers(m_layerSizes);
+
+  os << std::endl << std::endl;
+}
+
+/* Restores everything Train needs from a checkpoint written by an earlier
+ * run: the run seed, the settings that change results, where training
+ * stood, every player's weights and the hall of fame. Only the number of
+ * worker threads is asked for, as it does not change the results. Call
+ * SetHallOfFameCapacity first if the champions should spill.
+ */
+bool Population::Resume(const std::string &path, std::istream &is,
+                        std::ostream &os) {
+  CheckpointReader reader;
+  if (!reader.open(path)) {
+    return false;
+  }
+
+  uint64_t seed;
+  int32_t stage;
+  uint32_t precision, method, tournamentSize, playerCount, numLayers;
+  bool ok = reader.read(seed) && reader.read(m_populationSize) &&
+            reader.read(m_iterations) && reader.read(m_gamesToSimulate) &&
+            reader.read(precision) && reader.read(method) &&
+            reader.read(tournamentSize) && reader.read(m_hofRecent) &&
+            reader.read(m_hofOlder) && reader.read(stage) &&
+            reader.read(m_generation) && reader.read(m_epoch) &&
+            reader.read(m_greedyPercent) && reader.read(m_mutationRate) &&
+            reader.read(playerCount) && reader.read(numLayers);
+  std::vector<unsigned int> layerSizes(ok ? numLayers : 0);
+  for (size_t i = 0; ok && i < layerSizes.size(); ++i) {
+    ok = reader.read(layerSizes[i]);
+  }
+  if (!ok || m_populationSize < 2 || layerSizes.size() < 2) {
+    std::cerr << "Error: Checkpoint " << path << " is incomplete" << std::endl;
+    return false;
+  }
+  RandomStream::setRunSeed(seed);
+  m_precision = (Precision)precision;
+  m_selection.setMethod((SelectionMethod)method, tournamentSize);
+  m_stage = (TrainingStage)stage;
+
+  initThreads(is, os);
+  for (size_t i = 0; i < m_population.size(); ++i) {
+    delete m_population[i];
+  }
+  m_population.clear();
+  createPlayers(layerSizes);
+
+  // Players are restored in their sorted order, each into its own slot
+  for (int i = 0; ok && i < m_populationSize; ++i) {
+    NeuralPlayer *player = static_cast<NeuralPlayer *>(m_population[i]);
+    ok = reader.read(player->index) && reader.read(player->fitness) &&
+         reader.read(player->neural.parameters(),
+                     sizeof(double) * player->neural.numParameters());
+  }
+
+  // Champions were copies of the best player, so they get its precision
+  // here and its kernel in Train. Creating the template counts as a
+  // player, hence it comes before Player::count is restored.
+  uint64_t numChampions = 0;
+  ok = ok && reader.read(numChampions);
+  m_hallOfFame.clear();
+  m_hallOfFame.setCapacity(m_hofCapacity, spillPath(path));
+  m_restoredChampions = 0;
+  if (ok && numChampions > 0) {
+    RandomStream random = RandomStream::get(RandomPurpose::Player, 0, 0);
+    NeuralPlayer champion(layerSizes, random);
+    for (uint64_t c = 0; ok && c < numChampions; ++c) {
+      ok = reader.read(champion.neural.parameters(),
+                       sizeof(double) * champion.neural.numParameters());
+      champion.neural.setPrecision(m_precision);
+      addChampion(champion);
+    }
+    m_restoredChampions = (size_t)numChampions;
+  }
+  Player::count = playerCount;
+  if (!ok) {
+    std::cerr << "Error: Checkpoint " << path << " is incomplete" << std::endl;
+    return false;
+  }
+
+  os << std::endl << std::endl;
+  return true;
+}
+
+// Asks for the number of worker threads and starts the pool
+void Population::initThreads(std::istream &is, std::ostream &os) {
+  int numThreads;
+  os << "Worker threads (0 for all cores): ";
+  is >> numThreads;
+  if (numThreads < 0 || std::cin.fail()) {
+    std::cin.clear();
+    std::cin.ignore();
+    numThreads = 1;
+  }
+  m_numThreads = (numThreads == 0) ? ThreadPool::hardwareThreads()
+                                   : (unsigned int)numThreads;
+  delete m_pool;
+  m_pool = new ThreadPool(m_numThreads);
+}
+
+// Instantiates the Players, each bound to its own slot of the arena
+void Population::createPlayers(const std::vector<unsigned int> &layerSizes) {
   m_population.reserve(m_populationSize);
   for (int i = 0; i < m_populationSize; ++i) {
-    m_population.push_back(new NeuralPlayer(m_layerSizes));
+    RandomStream random = RandomStream::get(RandomPurpose::Weights, 0, i);
+    m_population.push_back(new NeuralPlayer(layerSizes, random));
+  }
+  m_arena.reset(m_populationSize, static_cast<NeuralPlayer *>(m_population[0])
+                                      ->neural.numParameters());
+  for (int i = 0; i < m_populationSize; ++i) {
+    static_cast<NeuralPlayer *>(m_population[i])->neural.bind(&m_arena, i);
   }
+}
 
-  m_hallOfFame.reserve(m_iterations);
-  os << std::endl << std::endl;
+/* Lockstep evaluation keeps many games in flight per worker and scores the
+ * positions waiting on the same network together. It pays off for large
+ * populations and game counts.
+ */
+void Population::SetEvaluationMode(EvaluationMode mode) {
+  m_evaluationMode = mode;
 }
 
-template <class Game>
+// Float inference runs the networks in single precision with the SIMD
+// activations, trading a little accuracy for speed
+void Population::SetPrecision(Precision precision) { m_precision = precision; }
+
+// Parent selection used by Breed; fitness-proportional by default
+void Population::SetSelection(SelectionMethod method,
+                              unsigned int tournamentSize) {
+  m_selection.setMethod(method, tournamentSize);
+}
+
+/* Trains UltimateTTT players against Monte Carlo tree search instead of a
+ * RandomPlayer in playGames, for a stronger opponent at a fixed cost per
+ * move. The search is deterministic, so each player meets it once from
+ * each seat. The workers share the player, so give it one thread each.
+ */
+void Population::SetMCTSOpponent(const MCTSSettings &settings) {
+  delete m_searchOpponent;
+  m_searchOpponent = new MCTSPlayer(settings);
+}
+
+/* Plays the best player against the 'recent' latest champions and one
+ * champion drawn from each of 'older' equal slices of the rest, instead of
+ * every champion, so the cost per generation stays bounded on long runs.
+ * 0 for both, the default, plays them all.
+ */
+void Population::SetHallOfFameSampling(unsigned int recent,
+                                       unsigned int older) {
+  m_hofRecent = recent;
+  m_hofOlder = older;
+}
+
+/* Keeps the weights of only the latest 'capacity' champions in memory and
+ * spills older ones to 'spillPath', see HallOfFame. 0, the default, keeps
+ * them all. Without a path the spill file goes beside the checkpoint, or
+ * is named after the run seed if there is none. Call before Resume.
+ */
+void Population::SetHallOfFameCapacity(size_t capacity,
+                                       const std::string &spillPath) {
+  m_hofCapacity = capacity;
+  m_spillPath = spillPath;
+}
+
+// Refreshes every network's inference copy after its weights changed
+void Population::preparePrecision() {
+  for (int i = 0; i < m_populationSize; ++i) {
+    static_cast<NeuralPlayer *>(m_population[i])
+        ->neural.setPrecision(m_precision);
+  }
+}
+
+template <class Game, class Net>
 double Population::Train(bool verbose) {
   using namespace std::chrono;
   auto startTime = steady_clock::now();
+  if (!m_tracePath.empty()) {
+    Tracer::start(m_traceEvents);
+  }
 
-  enum class TrainingStage { PlayRandom, RoundRobin, Both };
-  TrainingStage stage = TrainingStage::PlayRandom;
-  float greedyPercent = 0.02f;
-  float mutationRate = 0.05f;
-
-  std::cout << "STAGE 1: RANDOM PLAYERS" << std::endl;
-  for (int generation = 0; generation < m_iterations; ++generation) {
-    Player *opponent = new RandomPlayer(Game::NUM_ACTIONS);
-    switch (stage) {
+  bool fixed = true;
+  for (int i = 0; i < m_populationSize; ++i) {
+    NeuralPlayer *player = static_cast<NeuralPlayer *>(m_population[i]);
+    if (!Net::attach(player->neural)) {
+      std::cout << "Topology does not match the fixed network, using the "
+                   "dynamic one instead"
+                << std::endl;
+      for (int j = 0; j < i; ++j) {
+        NeuralNet::attach(static_cast<NeuralPlayer *>(m_population[j])->neural);
+      }
+      fixed = false;
+      break;
+    }
+  }
+  // Restored champions get the same kernel as the players they were copied from
+  for (size_t c = 0; c < m_restoredChampions; ++c) {
+    NeuralNet &neural = static_cast<NeuralPlayer *>(m_hallOfFame[c])->neural;
+    if (!fixed || !Net::attach(neural)) {
+      NeuralNet::attach(neural);
+    }
+  }
+  m_restoredChampions = 0;
+  m_hallOfFame.setCapacity(m_hofCapacity, spillPath(m_checkpointPath));
+  preparePrecision();
+
+  if (m_epoch == 0) {
+    std::cout << "STAGE 1: RANDOM PLAYERS" << std::endl;
+  } else {
+    std::cout << "RESUMING AT GENERATION " << m_generation << " OF STAGE "
+              << stageNumber() << std::endl;
+  }
+  steady_clock::time_point stageStart = steady_clock::now();
+  while (m_generation < m_iterations) {
+    TraceScope generationTrace("generation", m_epoch);
+    GenerationMetrics metrics = GenerationMetrics();
+    metrics.epoch = m_epoch;
+    metrics.stage = stageNumber();
+    metrics.generation = m_generation;
+    uint64_t gamesBefore = m_gamesPlayed;
+    uint64_t passesBefore = NeuralNet::forwardPasses();
+    steady_clock::time_point generationStart = steady_clock::now();
+    steady_clock::time_point phaseStart = generationStart;
+
+    switch (m_stage) {
       case TrainingStage::PlayRandom:
-        playGames<Game>(opponent);
+        playGames<Game>(m_epoch);
+        metrics.playGamesSeconds = lapSeconds(phaseStart);
         break;
       case TrainingStage::Both:
         roundRobin<Game>();
-        playGames<Game>(opponent);
+        metrics.roundRobinSeconds = lapSeconds(phaseStart);
+        playGames<Game>(m_epoch);
+        metrics.playGamesSeconds = lapSeconds(phaseStart);
         break;
       case TrainingStage::RoundRobin:
         roundRobin<Game>();
+        metrics.roundRobinSeconds = lapSeconds(phaseStart);
       default:
         break;
     }
-    delete opponent;
 
-    sort(m_population.begin(), m_population.end(), Player::ComparePlayer);
+    {
+      TraceScope trace("sort");
+      sort(m_population.begin(), m_population.end(), Player::ComparePlayer);
+    }
+    metrics.sortSeconds = lapSeconds(phaseStart);
+    metrics.minFitness = m_population[0]->fitness;
+    metrics.medianFitness = m_population[m_populationSize / 2]->fitness;
+    metrics.maxFitness = m_population[m_populationSize - 1]->fitness;
     NeuralPlayer *curBest = static_cast<NeuralPlayer *>(m_population.back());
     if (curBest == NULL) {
       throw new std::bad_cast();
     }
-    m_hallOfFame.push_back(new NeuralPlayer(*curBest));
+    addChampion(*curBest);
     if (verbose) {
       curBest->neural.printWeights();
     }
 
-    Statistics stats = playHallOfFame<Game>(m_population.back());
-    printSummary(generation, stats);
+    Statistics stats = playHallOfFame<Game>(m_population.back(), m_epoch);
+    metrics.hallOfFameSeconds = lapSeconds(phaseStart);
+    metrics.hallOfFameGames = stats.games;
+    metrics.winPercent = stats.winPercent;
+    metrics.lossPercent = stats.lossPercent;
+    metrics.tiePercent = stats.tiePercent;
+    printSummary(m_generation, stats);
 
     // Stage selection
-    switch (stage) {
+    int stage = stageNumber();
+    switch (m_stage) {
       case TrainingStage::PlayRandom:
-        if (generation == m_iterations - 1) {
-          stage = TrainingStage::Both;
-          generation = 0;
-          mutationRate = 0.03f;
-          greedyPercent = 0.05f;
+        if (m_generation == m_iterations - 1) {
+          m_stage = TrainingStage::Both;
+          m_generation = 0;
+          m_mutationRate = 0.03f;
+          m_greedyPercent = 0.05f;
           std::cout << "MOVING TO STAGE 2: ROUND ROBIN & RANDOM PLAYERS"
                     << std::endl;
         }
         break;
       case TrainingStage::Both:
-        if (generation == m_iterations - 1) {
-          stage = TrainingStage::RoundRobin;
-          generation = 0;
-          mutationRate = 0.01f;
-          greedyPercent = 0.08f;
+        if (m_generation == m_iterations - 1) {
+          m_stage = TrainingStage::RoundRobin;
+          m_generation = 0;
+          m_mutationRate = 0.01f;
+          m_greedyPercent = 0.08f;
           std::cout << "MOVING TO STAGE 3: ROUND ROBIN" << std::endl;
         }
         break;
@@ -198,18 +537,149 @@ double Population::Train(bool verbose) {
         break;
     }
 
-    Genetic::Breed(&m_population, greedyPercent);
-    Genetic::Mutate(&m_population, greedyPercent, mutationRate);
+    if (stageNumber() != stage && Tracer::isEnabled()) {
+      Tracer::record("stage", stageStart, stage);
+      stageStart = steady_clock::now();
+    }
+
+    lapSeconds(phaseStart);
+    Genetic::Breed(&m_population, &m_arena, &m_selection, m_greedyPercent,
+                   m_epoch);
+    metrics.breedSeconds = lapSeconds(phaseStart);
+    Genetic::Mutate(&m_population, m_greedyPercent, m_mutationRate, m_epoch);
+    metrics.mutateSeconds = lapSeconds(phaseStart);
+    preparePrecision();
 
     // Reset fitness values for next generation
     for (int i = 0; i < m_populationSize; ++i) {
       m_population[i]->fitness = 0.0f;
     }
+
+    if (m_metrics.isOpen()) {
+      metrics.totalSeconds = lapSeconds(generationStart);
+      metrics.games = m_gamesPlayed - gamesBefore;
+      metrics.forwardPasses = NeuralNet::forwardPasses() - passesBefore;
+      metrics.gamesPerSecond =
+          metrics.games / std::max(metrics.totalSeconds, 1e-9);
+      m_metrics.write(metrics);
+    }
+
+    ++m_generation;
+    ++m_epoch;
+    if (m_checkpointInterval > 0 && m_epoch % m_checkpointInterval == 0) {
+      saveCheckpoint();
+    }
+  }
+  m_checkpointWriter.wait();
+  INSTRUMENT_REPORT(std::cout);
+  if (Tracer::isEnabled()) {
+    Tracer::record("stage", stageStart, stageNumber());
+    Tracer::stop();
+    Tracer::dump(m_tracePath);
   }
   auto endTime = steady_clock::now();
   return duration_cast<milliseconds>(endTime - startTime).count() / 1000.0;
 }
 
+/* Saves the complete training state to 'path' every 'interval'
+ * generations, counted across stages; 0 turns checkpoints off. The state
+ * is copied between generations and written on a background thread while
+ * training goes on. Pass the file to Resume to continue the run.
+ */
+void Population::SetCheckpoint(const std::string &path,
+                               unsigned int interval) {
+  m_checkpointPath = path;
+  m_checkpointInterval = interval;
+}
+
+/* Appends a record per generation to 'path' with the wall time of each
+ * phase, the games played and networks evaluated, and the summary line's
+ * figures. See MetricsLog for the formats.
+ */
+bool Population::SetMetricsLog(const std::string &path,
+                               MetricsFormat format) {
+  return m_metrics.open(path, format);
+}
+
+/* Records a timeline of the next Train call, with spans for each stage,
+ * generation and phase and for every task the workers run, and writes it
+ * to 'path' as Chrome trace JSON at the end. Each thread keeps only its
+ * latest 'eventsPerThread' spans, about 32 bytes each.
+ */
+void Population::SetTrace(const std::string &path, size_t eventsPerThread) {
+  m_tracePath = path;
+  m_traceEvents = eventsPerThread;
+}
+
+int Population::stageNumber() const {
+  switch (m_stage) {
+    case TrainingStage::PlayRandom:
+      return 1;
+    case TrainingStage::Both:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+double Population::lapSeconds(std::chrono::steady_clock::time_point &start) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(now - start).count();
+  start = now;
+  return seconds;
+}
+
+/* Written between generations, after breeding, so the state is that of the
+ * start of the next one. Every random stream is derived from the run seed
+ * and the epoch, so those two stand in for the state of the generators.
+ * Here the state is only copied into the writer's buffer; the checksum and
+ * the file are left to its thread. The field order must match Resume.
+ */
+void Population::saveCheckpoint() {
+  TraceScope trace("checkpoint", m_epoch);
+  CheckpointWriter &writer = m_checkpointWriter;
+  writer.begin();
+  writer.write(RandomStream::getRunSeed());
+  writer.write(m_populationSize);
+  writer.write(m_iterations);
+  writer.write(m_gamesToSimulate);
+  writer.write((uint32_t)m_precision);
+  writer.write((uint32_t)m_selection.getMethod());
+  writer.write((uint32_t)m_selection.getTournamentSize());
+  writer.write(m_hofRecent);
+  writer.write(m_hofOlder);
+  writer.write((int32_t)m_stage);
+  writer.write(m_generation);
+  writer.write(m_epoch);
+  writer.write(m_greedyPercent);
+  writer.write(m_mutationRate);
+  writer.write((uint32_t)Player::count);
+
+  const NeuralNet &first =
+      static_cast<const NeuralPlayer *>(m_population[0])->neural;
+  const std::vector<unsigned int> &layerSizes = first.getLayerSizes();
+  writer.write((uint32_t)layerSizes.size());
+  writer.write(layerSizes.data(), sizeof(unsigned int) * layerSizes.size());
+
+  for (int i = 0; i < m_populationSize; ++i) {
+    const NeuralPlayer *player =
+        static_cast<const NeuralPlayer *>(m_population[i]);
+    writer.write(player->index);
+    writer.write(player->fitness);
+    writer.write(player->neural.parameters(),
+                 sizeof(double) * player->neural.numParameters());
+  }
+
+  writer.write((uint64_t)m_hallOfFame.size());
+  for (size_t c = 0; c < m_hallOfFame.size(); ++c) {
+    const NeuralNet &champion =
+        static_cast<const NeuralPlayer *>(m_hallOfFame[c])->neural;
+    writer.write(champion.parameters(),
+                 sizeof(double) * champion.numParameters());
+  }
+  writer.commit(m_checkpointPath);
+}
+
 bool Population::SaveBestPlayer(std::string path) {
   NeuralPlayer *playerNeural =
       dynamic_cast<NeuralPlayer *>(m_population.back());
@@ -228,73 +698,292 @@ void Population::playTestGame(Player *loadedPlayer) {
   testGame2.playGame();
 }
 
+/* Every pair of players meets twice, once from each seat. Games run on the
+ * worker pool and only record their results; fitness is then reduced per
+ * player in the same order the serial loop would add it, so the totals are
+ * identical for any thread count.
+ */
 template <class Game>
 void Population::roundRobin() {
-  for (int i = 0; i < m_populationSize - 1; ++i) {
-    for (int j = i + 1; j < m_populationSize; ++j) {
-      Game game1(m_population[i], m_population[j], false);
-      game1.playGame();
-      Game game2(m_population[j], m_population[i], false);
-      game2.playGame();
-    }
+  TraceScope trace("roundRobin");
+  const size_t n = (size_t)m_populationSize;
+  // Results of pair (i, j), i < j, start at 2 * rowOffset(i) + 2 * (j - i - 1)
+  // with the game where i moves first followed by the return game
+  std::vector<size_t> rowOffset(n, 0);
+  for (size_t i = 1; i < n; ++i) {
+    rowOffset[i] = rowOffset[i - 1] + (n - i);
   }
+  std::vector<GameResult> results(n * (n - 1));
+  m_gamesPlayed += results.size();
+
+  if (m_evaluationMode == EvaluationMode::Lockstep) {
+    // Fixed blocks of games so batches do not depend on the thread count
+    const size_t blockSize = 1024;
+    size_t numBlocks = (results.size() + blockSize - 1) / blockSize;
+    m_pool->parallelFor(
+        numBlocks, [&](size_t begin, size_t end, unsigned int) {
+          LockstepScheduler<Game> scheduler;
+          std::vector<Game> games;
+          games.reserve(blockSize);
+          for (size_t block = begin; block < end; ++block) {
+            size_t first = block * blockSize;
+            size_t last = std::min(first + blockSize, results.size());
+            games.clear();
+            for (size_t g = first; g < last; ++g) {
+              size_t pair = g / 2;
+              size_t i = std::upper_bound(rowOffset.begin(), rowOffset.end(),
+                                          pair) -
+                         rowOffset.begin() - 1;
+              size_t j = i + 1 + (pair - rowOffset[i]);
+              if (g % 2 == 0) {
+                games.push_back(Game(m_population[i], m_population[j]));
+              } else {
+                games.push_back(Game(m_population[j], m_population[i]));
+              }
+              scheduler.add(&games.back());
+            }
+            scheduler.run();
+            for (size_t g = first; g < last; ++g) {
+              results[g] = games[g - first].result();
+            }
+          }
+        });
+  } else {
+    m_pool->parallelFor(
+        n, [&](size_t begin, size_t end, unsigned int) {
+          for (size_t i = begin; i < end; ++i) {
+            GameResult *row = &results[2 * rowOffset[i]];
+            for (size_t j = i + 1; j < n; ++j) {
+              Game game1(m_population[i], m_population[j], false);
+              row[2 * (j - i - 1)] = game1.playGame();
+              Game game2(m_population[j], m_population[i], false);
+              row[2 * (j - i - 1) + 1] = game2.playGame();
+            }
+          }
+        });
+  }
+
+  // Each player's fitness is written by exactly one worker
+  m_pool->parallelFor(n, [&](size_t begin, size_t end, unsigned int) {
+    for (size_t p = begin; p < end; ++p) {
+      double fitness = m_population[p]->fitness;
+      for (size_t i = 0; i < p; ++i) {
+        const GameResult *pair = &results[2 * (rowOffset[i] + (p - i - 1))];
+        fitness += pair[0].player2Reward;
+        fitness += pair[1].player1Reward;
+      }
+      const GameResult *row = &results[2 * rowOffset[p]];
+      for (size_t j = p + 1; j < n; ++j) {
+        fitness += row[2 * (j - p - 1)].player1Reward;
+        fitness += row[2 * (j - p - 1) + 1].player2Reward;
+      }
+      m_population[p]->fitness = fitness;
+    }
+  });
 }
 
+/* Every player takes on a RandomPlayer, or the MCTS opponent, from both
+ * seats. Game k of player i draws from its own stream, keyed by
+ * 'generation', i and k, so the games a player sees do not depend on which
+ * worker ran them, on the thread count or on the evaluation mode.
+ */
 template <class Game>
-void Population::playGames(Player *opponent) {
-  for (int i = 0; i < m_populationSize; ++i) {
-    Game game1(m_population[i], opponent, false);
-    Game game2(opponent, m_population[i], false);
-    for (int j = 0; j <= m_gamesToSimulate / 2; ++j) {
-      game1.playGame();
-      game1.Reset();
-      game2.playGame();
-      game2.Reset();
+void Population::playGames(unsigned int generation) {
+  TraceScope trace("playGames", generation);
+  int numPairs = (m_searchOpponent != NULL) ? 1 : m_gamesToSimulate / 2 + 1;
+  m_gamesPlayed += (uint64_t)m_populationSize * 2 * numPairs;
+  // Lockstep has all of a player's games in flight, each with an opponent
+  size_t perWorker =
+      (m_evaluationMode == EvaluationMode::Lockstep) ? 2 * numPairs : 1;
+  std::vector<RandomPlayer> opponents(m_pool->size() * perWorker,
+                                      RandomPlayer(Game::NUM_ACTIONS));
+
+  m_pool->parallelFor(
+      m_populationSize, [&](size_t begin, size_t end, unsigned int worker) {
+        RandomPlayer *random = &opponents[worker * perWorker];
+        if (m_evaluationMode == EvaluationMode::Lockstep) {
+          playGamesLockstep<Game>(begin, end, random, numPairs, generation);
+          return;
+        }
+        Player *opponent = random;
+        if (m_searchOpponent != NULL) {
+          opponent = m_searchOpponent;
+        }
+        for (size_t i = begin; i < end; ++i) {
+          Game game1(m_population[i], opponent, false);
+          Game game2(opponent, m_population[i], false);
+          for (int j = 0; j < numPairs; ++j) {
+            random->reseed(RandomStream::get(RandomPurpose::Opponent,
+                                             generation, (uint32_t)i, 2 * j));
+            m_population[i]->fitness += game1.playGame().player1Reward;
+            game1.Reset();
+            random->reseed(RandomStream::get(
+                RandomPurpose::Opponent, generation, (uint32_t)i, 2 * j + 1));
+            m_population[i]->fitness += game2.playGame().player2Reward;
+            game2.Reset();
+          }
+        }
+      });
+}
+
+// Plays all of a player's games at once, for players [begin, end). Game k
+// is played against opponents[k], which draws from the stream of game k in
+// playGames, so both modes give the same fitness.
+template <class Game>
+void Population::playGamesLockstep(size_t begin, size_t end,
+                                   RandomPlayer *opponents, int numPairs,
+                                   unsigned int generation) {
+  LockstepScheduler<Game> scheduler;
+  std::vector<Game> games;
+  games.reserve(2 * numPairs);
+  for (size_t i = begin; i < end; ++i) {
+    games.clear();
+    for (int j = 0; j < numPairs; ++j) {
+      for (int k = 2 * j; k <= 2 * j + 1; ++k) {
+        opponents[k].reseed(RandomStream::get(RandomPurpose::Opponent,
+                                              generation, (uint32_t)i, k));
+      }
+      Player *opponent1 = &opponents[2 * j];
+      Player *opponent2 = &opponents[2 * j + 1];
+      if (m_searchOpponent != NULL) {
+        opponent1 = m_searchOpponent;
+        opponent2 = m_searchOpponent;
+      }
+      games.push_back(Game(m_population[i], opponent1));
+      scheduler.add(&games.back());
+      games.push_back(Game(opponent2, m_population[i]));
+      scheduler.add(&games.back());
+    }
+    scheduler.run();
+    for (int j = 0; j < numPairs; ++j) {
+      m_population[i]->fitness += games[2 * j].result().player1Reward;
+      m_population[i]->fitness += games[2 * j + 1].result().player2Reward;
     }
   }
 }
 
-template <class Game>
-Statistics Population::playHallOfFame(Player *best) {
-  int numOpponents = m_hallOfFame.size() - 1;
-  double initialFitness = best->fitness;
-  int numWins = 0;
-  int numTies = 0;
-  int numLoss = 0;
-  for (int i = 0; i < numOpponents; ++i) {
-    best->fitness = 0.0f;
-    Game game1(m_hallOfFame[i], best, false);
-    game1.playGame();
+// 95% Wilson score interval of 'count' successes in 'trials', in percent
+inline void wilsonInterval(int count, int trials, double *low, double *high) {
+  if (trials == 0) {
+    *low = 0.0;
+    *high = 100.0;
+    return;
+  }
+  const double z = 1.96;
+  double n = trials;
+  double p = count / n;
+  double denominator = 1.0 + z * z / n;
+  double centre = (p + z * z / (2.0 * n)) / denominator;
+  double spread =
+      z * std::sqrt(p * (1.0 - p) / n + z * z / (4.0 * n * n)) / denominator;
+  *low = 100.0 * std::max(0.0, centre - spread);
+  *high = 100.0 * std::min(1.0, centre + spread);
+}
 
-    // Check if best won or not
-    if (best->fitness > 1.0) {
-      numWins++;
-    } else if (best->fitness >= 0.5) {
-      numTies++;
-    } else {
-      numLoss++;
+/* Champions 0 .. numChampions-1 to play: all of them, or the most recent
+ * m_hofRecent plus one from each of m_hofOlder equal slices of the older
+ * ones, drawn from the HallOfFame stream for 'generation'.
+ */
+void Population::sampleHallOfFame(size_t numChampions, unsigned int generation,
+                                  std::vector<size_t> &sample) const {
+  sample.clear();
+  size_t numRecent = std::min<size_t>(m_hofRecent, numChampions);
+  size_t numOlder = numChampions - numRecent;
+  if ((m_hofRecent == 0 && m_hofOlder == 0) || numOlder <= m_hofOlder) {
+    for (size_t i = 0; i < numChampions; ++i) {
+      sample.push_back(i);
     }
+    return;
+  }
+
+  RandomStream random =
+      RandomStream::get(RandomPurpose::HallOfFame, generation, 0);
+  for (size_t s = 0; s < m_hofOlder; ++s) {
+    size_t begin = numOlder * s / m_hofOlder;
+    size_t end = numOlder * (s + 1) / m_hofOlder;
+    sample.push_back(begin + random.below((unsigned int)(end - begin)));
+  }
+  for (size_t i = numOlder; i < numChampions; ++i) {
+    sample.push_back(i);
+  }
+}
+
+/* The spill file for this run: the one set by SetHallOfFameCapacity, else
+ * one beside the checkpoint, else one named after the run seed, so runs
+ * sharing a directory do not share a spill file.
+ */
+std::string Population::spillPath(const std::string &checkpointPath) const {
+  if (!m_spillPath.empty()) {
+    return m_spillPath;
+  }
+  if (!checkpointPath.empty()) {
+    return checkpointPath + ".spill";
+  }
+  return "hall_of_fame_" + std::to_string(RandomStream::getRunSeed()) +
+         ".spill";
+}
 
-    best->fitness = 0;
-    Game game2(best, m_hallOfFame[i], false);
-    game2.playGame();
+// If the spill file fails, the hall of fame stays in memory from then on
+void Population::addChampion(const NeuralPlayer &champion) {
+  if (!m_hallOfFame.add(champion)) {
+    std::cerr << "Error: Keeping the hall of fame in memory from now on"
+              << std::endl;
+    m_hofCapacity = 0;
+    m_hallOfFame.setCapacity(0, spillPath(m_checkpointPath));
+  }
+}
+
+/* The best player meets each sampled champion from both seats. The games
+ * run on the worker pool and are tallied afterwards in sample order.
+ */
+template <class Game>
+Statistics Population::playHallOfFame(Player *best, unsigned int generation) {
+  TraceScope trace("playHallOfFame", generation);
+  // The last entry is the best player itself
+  size_t numChampions = m_hallOfFame.size() - 1;
+  std::vector<size_t> sample;
+  sampleHallOfFame(numChampions, generation, sample);
 
-    // Check if best won or not
-    if (best->fitness > 1.0) {
+  std::vector<GameResult> results(2 * sample.size());
+  m_gamesPlayed += results.size();
+  m_pool->parallelFor(
+      sample.size(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t k = begin; k < end; ++k) {
+          Player *champion = m_hallOfFame[sample[k]];
+          Game game1(champion, best, false);
+          results[2 * k] = game1.playGame();
+          Game game2(best, champion, false);
+          results[2 * k + 1] = game2.playGame();
+        }
+      });
+  return tally(results);
+}
+
+Statistics Population::tally(const std::vector<GameResult> &results) {
+  int numWins = 0;
+  int numTies = 0;
+  int numLoss = 0;
+  for (size_t g = 0; g < results.size(); ++g) {
+    // Check if best won or not; it plays second in the even games
+    int bestSeat = (g % 2 == 0) ? 2 : 1;
+    if (results[g].winner == bestSeat) {
       numWins++;
-    } else if (best->fitness >= 0.5) {
+    } else if (results[g].winner == 0) {
       numTies++;
     } else {
       numLoss++;
     }
   }
-  Statistics ret;
-  ret.winPercent = 100.0 * numWins / (2 * numOpponents);
-  ret.lossPercent = 100.0 * numLoss / (2 * numOpponents);
-  ret.tiePercent = 100.0 * numTies / (2 * numOpponents);
 
-  // Set the best player's fitness to what it was before this function
-  best->fitness = initialFitness;
+  Statistics ret;
+  ret.games = (int)results.size();
+  double games = std::max(ret.games, 1);
+  ret.winPercent = 100.0 * numWins / games;
+  ret.lossPercent = 100.0 * numLoss / games;
+  ret.tiePercent = 100.0 * numTies / games;
+  wilsonInterval(numWins, ret.games, &ret.winLow, &ret.winHigh);
+  wilsonInterval(numLoss, ret.games, &ret.lossLow, &ret.lossHigh);
+  wilsonInterval(numTies, ret.games, &ret.tieLow, &ret.tieHigh);
   return ret;
 }
 
@@ -308,9 +997,16 @@ void Population::printSummary(const int generation, Statistics stats) const {
   printf(", Median: %-6.1f [i=%-3d]", medPlayer->fitness, medPlayer->index);
   printf(", Max: %-6.1f [i=%-3d]", maxPlayer->fitness, maxPlayer->index);
   printf("  HOF: ");
-  printf("W: %.2lf%%, ", stats.winPercent);
-  printf("L: %.2lf%%, ", stats.lossPercent);
-  printf("T: %.2lf%%", stats.tiePercent);
+  if (stats.games == 0) {
+    printf("no games");
+  } else {
+    printf("W: %.2lf%% [%.1lf-%.1lf], ", stats.winPercent, stats.winLow,
+           stats.winHigh);
+    printf("L: %.2lf%% [%.1lf-%.1lf], ", stats.lossPercent, stats.lossLow,
+           stats.lossHigh);
+    printf("T: %.2lf%% [%.1lf-%.1lf] of %d", stats.tiePercent, stats.tieLow,
+           stats.tieHigh, stats.games);
+  }
   std::cout << std::endl;
 }
 
@@ -336,9 +1032,26 @@ void Population::PlayBest() {
   playTestGame<Game>(m_population.back());
 }
 
+/* Plays the best player against 'opponent', such as an MCTSPlayer, once
+ * from each seat, as a yardstick for how far training got. Both players
+ * are deterministic, so further games would repeat these.
+ */
+template <class Game>
+Statistics Population::Benchmark(Player *opponent) {
+  std::vector<GameResult> results(2);
+  Game game1(opponent, m_population.back(), false);
+  results[0] = game1.playGame();
+  Game game2(m_population.back(), opponent, false);
+  results[1] = game2.playGame();
+  return tally(results);
+}
+
 Player *Population::LoadPlayerFromFile(std::string path) {
   NeuralPlayer *temp = new NeuralPlayer();
-  temp->neural.loadFromFile(path);
+  // Binary models are mapped, older text ones are read in
+  if (!temp->neural.mapFromFile(path)) {
+    temp->neural.loadFromFile(path);
+  }
   return temp;
 }
 
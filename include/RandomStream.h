@@ -0,0 +1,60 @@
+#ifndef RANDOMSTREAM_H
+#define RANDOMSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Philox.h"
+
+// What a stream is used for; each purpose draws from its own key
+enum class RandomPurpose : uint32_t {
+  Weights = 1,  // initial network weights
+  Opponent,     // RandomPlayer moves in playGames
+  Selection,    // parent selection in Breed
+  Crossover,    // weight choice in Breed
+  Mutation,     // noise added in Mutate
+  Player,       // players created outside training
+  Exploration,  // sampled moves in TicTacToe
+  Search,       // playouts in MCTSPlayer
+  HallOfFame    // champions sampled by playHallOfFame
+};
+
+/* All randomness in a run comes from one run seed. get() hands out an
+ * independent stream for each (purpose, generation, individual), backed by
+ * a Philox counter, so a result depends only on the seed and on which
+ * generation and individual it belongs to, never on which thread drew it
+ * or in which order. Streams are cheap to create and copy; set the run
+ * seed before training starts.
+ */
+class RandomStream {
+ public:
+  RandomStream(uint64_t key, uint64_t stream);
+
+  static RandomStream get(RandomPurpose purpose, uint32_t generation,
+                          uint32_t individual);
+  // One of several independent streams of the same individual, such as
+  // one per game it plays
+  static RandomStream get(RandomPurpose purpose, uint32_t generation,
+                          uint32_t individual, uint32_t sequence);
+  static void setRunSeed(uint64_t seed);
+  static uint64_t getRunSeed();
+  // A seed that differs from run to run, for when none is given
+  static uint64_t timeSeed();
+
+  uint32_t next();
+  // Uniform in [0, 1) with 53 random bits
+  double uniform();
+  // Uniform integer in [0, bound)
+  unsigned int below(unsigned int bound);
+  void addNormal(double *values, size_t count, double stddev);
+
+ private:
+  static uint64_t runSeed;
+
+  Philox m_generator;
+  uint64_t m_stream;
+  uint64_t m_block;
+  uint32_t m_words[4];
+  int m_used;
+};
+
+#endif
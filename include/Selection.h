@@ -0,0 +1,49 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <vector>
+#include "Player.h"
+#include "RandomStream.h"
+
+// How Genetic::Breed picks parents
+enum class SelectionMethod {
+  Proportional,  // chance proportional to fitness
+  Tournament,    // fittest of a few players drawn uniformly
+  Rank           // chance proportional to position in the sorted population
+};
+
+/* Parent selection over one generation. prepare() does the O(N) work once
+ * per generation, after which pick() costs O(log N) for proportional,
+ * O(1) for rank and O(tournament size) for tournament selection, and only
+ * reads shared state, so children can be bred in parallel.
+ */
+class Selection {
+ public:
+  Selection(SelectionMethod method = SelectionMethod::Proportional,
+            unsigned int tournamentSize = 3);
+
+  void setMethod(SelectionMethod method, unsigned int tournamentSize = 3);
+  SelectionMethod getMethod() const;
+  unsigned int getTournamentSize() const;
+  // Running totals there is room for; prepare() grows it when short
+  size_t reserved() const;
+
+  // 'population' must be sorted by ascending fitness and stay unchanged
+  // until the last pick()
+  void prepare(const std::vector<Player *> &population);
+  // Index of the chosen parent in the prepared population
+  unsigned int pick(RandomStream &random) const;
+
+ private:
+  SelectionMethod m_method;
+  unsigned int m_tournamentSize;
+  const std::vector<Player *> *m_population;
+  // Proportional: running totals of the (non-negative) fitness
+  std::vector<double> m_cumulative;
+
+  unsigned int pickProportional(RandomStream &random) const;
+  unsigned int pickTournament(RandomStream &random) const;
+  unsigned int pickRank(RandomStream &random) const;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SIMDACT_H
+#define SIMDACT_H
+
+#include <cstddef>
+
+/* In-place activation kernels for single-precision inference. The exp used
+ * by sigmoid and softmax is a polynomial approximation (relative error
+ * around 1e-6). Builds with AVX2 enabled (__AVX2__, e.g. -mavx2 or
+ * /arch:AVX2) process eight values per instruction; other builds use the
+ * same approximation one value at a time.
+ */
+class SimdActivations {
+ public:
+  static void sigmoid(float *values, size_t count);
+  static void relu(float *values, size_t count);
+  // Normalises each of the 'numRows' contiguous rows of 'rowSize' values
+  static void softmax(float *values, size_t numRows, size_t rowSize);
+
+  static float fastExp(float x);
+  static bool usesAvx2();
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef THREADCOUNTERS_H
+#define THREADCOUNTERS_H
+
+#include <cstdint>
+
+/* Event counters summed over all threads. Each thread adds to its own
+ * thread_local block of slots, so counting never contends; only a thread's
+ * first count and its exit take the lock. A finished thread adds its slots
+ * to the retired totals, so total() covers running and finished threads.
+ *
+ * ForwardRows is always counted. The slots from FirstInstrumented on belong
+ * to Instrumentation and are only written in TTT_INSTRUMENT builds.
+ */
+class ThreadCounters {
+ public:
+  enum Slot {
+    ForwardRows,        // rows scored by NeuralNet::forwardBatch
+    FirstInstrumented,  // Instrumentation's counters and timers
+    NumSlots = 16
+  };
+
+  static void add(int slot, uint64_t amount);
+  static uint64_t total(int slot);
+  // Only meant for when nothing is counting into 'slot'
+  static void reset(int slot);
+};
+
+#endif
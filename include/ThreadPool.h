@@ -0,0 +1,55 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A fixed set of worker threads that split index ranges between them.
+ * The calling thread takes part in every job as worker 0, so a pool of
+ * size 1 starts no threads and runs everything serially.
+ */
+class ThreadPool {
+ public:
+  // Task signature: task(begin, end, worker) handles indices [begin, end)
+  typedef std::function<void(size_t, size_t, unsigned int)> Task;
+
+  ThreadPool(unsigned int numThreads);
+  ~ThreadPool();
+
+  unsigned int size() const;
+
+  // Runs 'task' over [0, count) and blocks until every index is done.
+  // Jobs must not be nested.
+  void parallelFor(size_t count, const Task &task);
+
+  static unsigned int hardwareThreads();
+
+ private:
+  ThreadPool(const ThreadPool &other);
+  void operator=(const ThreadPool &right);
+
+  void workerLoop(unsigned int worker);
+  void runChunks(unsigned int worker);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  const Task *m_task;
+  size_t m_count;
+  size_t m_chunkSize;
+  std::atomic<size_t> m_next;
+  unsigned int m_active;
+  unsigned long m_jobId;
+  bool m_stop;
+  std::exception_ptr m_error;
+};
+
+#endif
@@ -9,55 +9,111 @@
 #include <type_traits>
 #include <vector>
 using namespace Eigen;
+#include "GameResult.h"
+#include "Instrumentation.h"
+#include "MoveSelection.h"
 #include "NeuralNet.h"
 #include "Player.h"
+#include "TicTacToePosition.h"
 
 enum States { empty = 0, playerX = 1, playerO = 2, invalid = 3 };
 
 class TicTacToe {
  public:
+  typedef Matrix<double, 1, 9> BoardVector;
+
   TicTacToe(Player *player1, Player *player2, bool verbose = false);
-  void playGame();
+  GameResult playGame();
   void Reset();
+  /* Plays a softmax sample of each player's scores instead of the best
+   * legal move. A temperature of 0, the default, turns this off.
+   */
+  void setExploration(const double temperature, const RandomStream &random);
+
+  /* Resumable play, used to batch network evaluations across many games.
+   * start() plays until a NeuralPlayer is to move. pendingBoards() then
+   * writes the boards it has to score and resume() takes those scores,
+   * plays the move and carries on to the next such turn.
+   */
+  void start();
+  bool isFinished() const;
+  const NeuralPlayer *pendingPlayer() const;
+  int pendingBoards(MatrixXd &boards, const Index row) const;
+  void resume(const double *scores);
+  GameResult result() const;
 
   static const int NUM_PERCEPTS = 9;
   static const int NUM_ACTIONS = 9;
+  static const uint16_t FULL_BOARD = 0x1FF;
+  // True if the squares set in the 9-bit 'mask' contain a line
+  static bool hasLine(const uint16_t mask);
+
+  // Board queries for Player::scoreMoves
+  States sideToMove() const;
+  uint16_t legalMoves() const;
+  BoardVector toPlayerPerspective(const States state) const;
+  int tableIndex() const;
+  TicTacToePosition toPosition() const;
+  int afterMoveBoards(const BoardVector &startBoard, Ref<MatrixXd> boards,
+                      const Index row, int *legalMoves) const;
 
  private:
   bool takeTurn(const States state, const int turn);
+  bool playMove(const States state, const int turn, const BoardVector &moves);
+  void advance();
 
   bool isEmpty() const;
   bool hasTied() const;
-  bool hasWon(int move) const;
+  bool hasWon(const States state) const;
 
-  RowVectorXd toRowVector() const;
-  RowVectorXd toPlayerPerspective(const States state) const;
+  BoardVector toRowVector() const;
 
   States getBoardAtPosition(const int position) const;
   void setBoardAtPosition(const int position, const States state);
 
-  inline RowVectorXi argSort(const RowVectorXd &input) const;
-  void printBoard(RowVectorXd moves, bool printProbabilities) const;
-  void populateMoves(const States state, RowVectorXd &moves, const int turn);
-  double minimax(const States state, const int turn, int prevMove);
+  void printBoard(const BoardVector &moves, bool printProbabilities) const;
+  void populateMoves(const States state, BoardVector &moves, const int turn);
 
   double winReward(const int turn) const;
   double tieReward(const int turn) const;
 
-  uint32_t m_board;
+  /* One 9-bit mask per side, bit i for square i: m_masks[0] holds X's
+   * squares and m_masks[1] O's. Empty squares are the bits in neither.
+   */
+  uint16_t m_masks[2];
 
   Player *m_player1;
   Player *m_player2;
 
+  GameResult m_result;
+  int m_turn;
+  bool m_finished;
   bool m_verbose;
+
+  double m_temperature;
+  RandomStream m_random;
 };
 
-TicTacToe::TicTacToe(Player *player1, Player *player2, bool verbose)
-    : m_player1(player1), m_player2(player2), m_verbose(verbose) {
-  m_board = (uint32_t)0;
+inline TicTacToe::TicTacToe(Player *player1, Player *player2, bool verbose)
+    : m_player1(player1),
+      m_player2(player2),
+      m_turn(0),
+      m_finished(false),
+      m_verbose(verbose),
+      m_temperature(0.0),
+      m_random(RandomStream::get(RandomPurpose::Exploration, 0, 0)) {
+  Reset();
 }
 
-void TicTacToe::playGame() {
+inline void TicTacToe::setExploration(const double temperature,
+                                      const RandomStream &random) {
+  m_temperature = temperature;
+  m_random = random;
+}
+
+// Plays until a player wins or the board is full
+inline GameResult TicTacToe::playGame() {
+  m_result = GameResult();
   int turn = 0;
   while (true) {
     if (takeTurn(States::playerX, turn)) {
@@ -69,42 +125,87 @@ void TicTacToe::playGame() {
     }
     turn++;
   }
+  return m_result;
+}
+
+inline void TicTacToe::Reset() {
+  m_masks[0] = 0;
+  m_masks[1] = 0;
 }
 
-void TicTacToe::Reset() { m_board = (uint32_t)0; }
+inline void TicTacToe::start() {
+  Reset();
+  m_result = GameResult();
+  m_turn = 0;
+  m_finished = false;
+  advance();
+}
 
-inline bool TicTacToe::isEmpty() const { return m_board == (uint32_t)0; }
+inline bool TicTacToe::isFinished() const { return m_finished; }
 
-inline bool TicTacToe::hasTied() const {
+inline GameResult TicTacToe::result() const { return m_result; }
+
+inline States TicTacToe::sideToMove() const {
+  return (m_turn % 2 == 0) ? States::playerX : States::playerO;
+}
+
+// The NeuralPlayer waiting on resume(), or NULL once the game is over
+inline const NeuralPlayer *TicTacToe::pendingPlayer() const {
+  if (m_finished) {
+    return NULL;
+  }
+  Player *current = (sideToMove() == States::playerX) ? m_player1 : m_player2;
+  return current->asNeural();
+}
+
+// Writes one board per legal move from 'row' on and returns how many
+inline int TicTacToe::pendingBoards(MatrixXd &boards, const Index row) const {
+  int legalMoves[9];
+  return afterMoveBoards(toPlayerPerspective(sideToMove()), boards, row,
+                         legalMoves);
+}
+
+// 'scores' holds one value per board written by pendingBoards()
+inline void TicTacToe::resume(const double *scores) {
+  BoardVector moves = BoardVector::Zero();
+  uint16_t legal = legalMoves();
+  int numLegal = 0;
   for (int i = 0; i < 9; ++i) {
-    if (getBoardAtPosition(i) == States::empty) {
-      return false;
+    if ((legal >> i) & 1) {
+      moves(i) = scores[numLegal++];
     }
   }
-  return true;
+  m_finished = playMove(sideToMove(), m_turn, moves);
+  m_turn++;
+  advance();
 }
 
-// Returns a vector of the preferred moves starting with most preferred
-inline RowVectorXi TicTacToe::argSort(const RowVectorXd &input) const {
-  Matrix<int, 1, 9> ret;
-  std::vector<std::pair<double, unsigned int>> inputPair;
-  inputPair.reserve(9);
-
-  // Populate inputPair
-  for (unsigned int i = 0; i < 9; ++i) {
-    inputPair.push_back(std::make_pair(input(i), i));
+// Plays turns that need no network until a NeuralPlayer is to move
+inline void TicTacToe::advance() {
+  while (!m_finished) {
+    Player *current = (sideToMove() == States::playerX) ? m_player1 : m_player2;
+    if (current->asNeural() != NULL) {
+      return;
+    }
+    m_finished = takeTurn(sideToMove(), m_turn);
+    m_turn++;
   }
+}
 
-  sort(inputPair.begin(), inputPair.end());
+inline bool TicTacToe::isEmpty() const {
+  return (m_masks[0] | m_masks[1]) == 0;
+}
 
-  // Populate ret
-  for (unsigned int i = 0; i < 9; ++i) {
-    ret(8 - i) = inputPair[i].second;
-  }
-  return ret;
+// The board is full once the two masks cover all nine squares
+inline bool TicTacToe::hasTied() const {
+  return (m_masks[0] | m_masks[1]) == FULL_BOARD;
 }
 
-inline void TicTacToe::printBoard(RowVectorXd moves,
+inline uint16_t TicTacToe::legalMoves() const {
+  return (uint16_t)(~(m_masks[0] | m_masks[1]) & FULL_BOARD);
+}
+
+inline void TicTacToe::printBoard(const BoardVector &moves,
                                   bool printProbabilities) const {
   std::cout << "+---+---+---+" << std::endl;
   for (int i = 0; i < 3; ++i) {
@@ -127,8 +228,8 @@ inline void TicTacToe::printBoard(RowVectorXd moves,
   std::cout << std::endl;
 }
 
-inline RowVectorXd TicTacToe::toRowVector() const {
-  RowVectorXd temp(9);
+inline TicTacToe::BoardVector TicTacToe::toRowVector() const {
+  BoardVector temp;
   for (int i = 0; i < 9; ++i) {
     temp(i) = (double)getBoardAtPosition(i);
   }
@@ -140,194 +241,131 @@ inline RowVectorXd TicTacToe::toRowVector() const {
     - opponent's squares   = -1
     - empty squares        =  0
  */
-inline RowVectorXd TicTacToe::toPlayerPerspective(const States state) const {
-  RowVectorXd temp = toRowVector();
+inline TicTacToe::BoardVector TicTacToe::toPlayerPerspective(
+    const States state) const {
+  uint16_t own = m_masks[(state == States::playerX) ? 0 : 1];
+  uint16_t opponent = m_masks[(state == States::playerX) ? 1 : 0];
+  BoardVector temp;
   for (int i = 0; i < 9; ++i) {
-    int cur = (int)temp(i);
-    if (cur == (int)States::empty) {
-      temp(i) = 0.0;
-    } else if (cur == (int)state) {
-      temp(i) = 1.0;
-    } else {
-      temp(i) = -1.0;
-    }
+    temp(i) = (double)((own >> i) & 1) - (double)((opponent >> i) & 1);
   }
   return temp;
 }
 
 inline States TicTacToe::getBoardAtPosition(const int position) const {
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-  uint32_t ret = m_board >> shiftAmount;
-  ret &= (uint32_t)3;
-  if (ret == (uint32_t)States::empty) {
-    return States::empty;
-  } else if (ret == (uint32_t)States::playerX) {
+  if ((m_masks[0] >> position) & 1) {
     return States::playerX;
-  } else if (ret == (uint32_t)States::playerO) {
+  } else if ((m_masks[1] >> position) & 1) {
     return States::playerO;
-  } else {
-    return States::invalid;
   }
+  return States::empty;
 }
 
 inline void TicTacToe::setBoardAtPosition(const int position,
                                           const States state) {
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-  // Clear the 2-bit-wide field
-  m_board &= ~((uint32_t)3 << shiftAmount);
-  // Set the new state at the 2-bit-wide field
-  uint32_t val = (uint32_t)state;
-  m_board |= (val << shiftAmount);
+  uint16_t bit = (uint16_t)(1 << position);
+  m_masks[0] &= (uint16_t)~bit;
+  m_masks[1] &= (uint16_t)~bit;
+  if (state == States::playerX) {
+    m_masks[0] |= bit;
+  } else if (state == States::playerO) {
+    m_masks[1] |= bit;
+  }
 }
 
-inline bool TicTacToe::hasWon(int move) const {
-  // Only need to check if the most recent move caused a win
-  switch (move) {
-    case 0:
-      if ((m_board & (uint32_t)65793) == (uint32_t)65793) return true;
-      if ((m_board & (uint32_t)86016) == (uint32_t)86016) return true;
-      if ((m_board & (uint32_t)66576) == (uint32_t)66576) return true;
-      if ((m_board & (uint32_t)131586) == (uint32_t)131586) return true;
-      if ((m_board & (uint32_t)172032) == (uint32_t)172032) return true;
-      if ((m_board & (uint32_t)133152) == (uint32_t)133152) return true;
-      break;
-    case 1:
-      if ((m_board & (uint32_t)86016) == (uint32_t)86016) return true;
-      if ((m_board & (uint32_t)16644) == (uint32_t)16644) return true;
-      if ((m_board & (uint32_t)172032) == (uint32_t)172032) return true;
-      if ((m_board & (uint32_t)33288) == (uint32_t)33288) return true;
-      break;
-    case 2:
-      if ((m_board & (uint32_t)4368) == (uint32_t)4368) return true;
-      if ((m_board & (uint32_t)86016) == (uint32_t)86016) return true;
-      if ((m_board & (uint32_t)4161) == (uint32_t)4161) return true;
-      if ((m_board & (uint32_t)8736) == (uint32_t)8736) return true;
-      if ((m_board & (uint32_t)172032) == (uint32_t)172032) return true;
-      if ((m_board & (uint32_t)8322) == (uint32_t)8322) return true;
-      break;
-    case 3:
-      if ((m_board & (uint32_t)1344) == (uint32_t)1344) return true;
-      if ((m_board & (uint32_t)66576) == (uint32_t)66576) return true;
-      if ((m_board & (uint32_t)2688) == (uint32_t)2688) return true;
-      if ((m_board & (uint32_t)133152) == (uint32_t)133152) return true;
-      break;
-    case 4:
-      if ((m_board & (uint32_t)65793) == (uint32_t)65793) return true;
-      if ((m_board & (uint32_t)4368) == (uint32_t)4368) return true;
-      if ((m_board & (uint32_t)1344) == (uint32_t)1344) return true;
-      if ((m_board & (uint32_t)16644) == (uint32_t)16644) return true;
-      if ((m_board & (uint32_t)131586) == (uint32_t)131586) return true;
-      if ((m_board & (uint32_t)8736) == (uint32_t)8736) return true;
-      if ((m_board & (uint32_t)2688) == (uint32_t)2688) return true;
-      if ((m_board & (uint32_t)33288) == (uint32_t)33288) return true;
-      break;
-    case 5:
-      if ((m_board & (uint32_t)1344) == (uint32_t)1344) return true;
-      if ((m_board & (uint32_t)4161) == (uint32_t)4161) return true;
-      if ((m_board & (uint32_t)2688) == (uint32_t)2688) return true;
-      if ((m_board & (uint32_t)8322) == (uint32_t)8322) return true;
-      break;
-    case 6:
-      if ((m_board & (uint32_t)4368) == (uint32_t)4368) return true;
-      if ((m_board & (uint32_t)21) == (uint32_t)21) return true;
-      if ((m_board & (uint32_t)66576) == (uint32_t)66576) return true;
-      if ((m_board & (uint32_t)8736) == (uint32_t)8736) return true;
-      if ((m_board & (uint32_t)42) == (uint32_t)42) return true;
-      if ((m_board & (uint32_t)133152) == (uint32_t)133152) return true;
-      break;
-    case 7:
-      if ((m_board & (uint32_t)21) == (uint32_t)21) return true;
-      if ((m_board & (uint32_t)16644) == (uint32_t)16644) return true;
-      if ((m_board & (uint32_t)42) == (uint32_t)42) return true;
-      if ((m_board & (uint32_t)33288) == (uint32_t)33288) return true;
-      break;
-    case 8:
-      if ((m_board & (uint32_t)65793) == (uint32_t)65793) return true;
-      if ((m_board & (uint32_t)21) == (uint32_t)21) return true;
-      if ((m_board & (uint32_t)4161) == (uint32_t)4161) return true;
-      if ((m_board & (uint32_t)131586) == (uint32_t)131586) return true;
-      if ((m_board & (uint32_t)42) == (uint32_t)42) return true;
-      if ((m_board & (uint32_t)8322) == (uint32_t)8322) return true;
-      break;
-    default:
-      break;
+// Index of the board in PerfectPlayTable
+inline int TicTacToe::tableIndex() const {
+  int index = 0;
+  for (int i = 0; i < 9; ++i) {
+    index = 3 * index + (int)getBoardAtPosition(i);
   }
-  return false;
+  return index;
+}
+
+inline TicTacToePosition TicTacToe::toPosition() const {
+  TicTacToePosition position;
+  for (int i = 0; i < 9; ++i) {
+    position.set(i, (int)getBoardAtPosition(i));
+  }
+  return position;
+}
+
+/* Bit m of WIN_MASKS is set if the squares in mask m contain a line, so a
+ * win is one table lookup on the side's mask.
+ */
+inline bool TicTacToe::hasLine(const uint16_t mask) {
+  static const uint32_t WIN_MASKS[16] = {
+      0x80808080, 0xFF808080, 0xFAF0AA80, 0xFFF0AA80, 0xCCCC8080, 0xFFCC8080,
+      0xFEFCAA80, 0xFFFCAA80, 0xAAAA8080, 0xFFFAF0F0, 0xFAFAAA80, 0xFFFAFAF0,
+      0xEEEE8080, 0xFFFEF0F0, 0xFFFFFFFF, 0xFFFFFFFF};
+  return (WIN_MASKS[mask >> 5] >> (mask & 31)) & 1;
+}
+
+inline bool TicTacToe::hasWon(const States state) const {
+  return hasLine(m_masks[(state == States::playerX) ? 0 : 1]);
 }
 
 inline double TicTacToe::winReward(const int turn) const {
   return 1.0 + (9.0 - turn) / 10.0;
 }
 
-inline double TicTacToe::tieReward(const int turn) const { return 1.0; }
+inline double TicTacToe::tieReward(const int) const { return 1.0; }
 
-inline void TicTacToe::populateMoves(const States state, RowVectorXd &moves,
-                                     const int turn) {
-  RowVectorXd startBoard = toPlayerPerspective(state);
+// One virtual call; each player type scores the board its own way
+inline void TicTacToe::populateMoves(const States state, BoardVector &moves,
+                                     const int) {
   Player *currentPlayer = (state == States::playerX) ? m_player1 : m_player2;
+  currentPlayer->scoreMoves(*this, legalMoves(), moves.data());
+}
 
-  ManualPlayer *manualPlayer = dynamic_cast<ManualPlayer *>(currentPlayer);
-  if (manualPlayer != NULL) {
-    double index = (manualPlayer->getMove(startBoard))(0);
-    moves((int)index) = 1.0;
-  }
-
-  PerfectPlayer *perfectPlayer = dynamic_cast<PerfectPlayer *>(currentPlayer);
-  if (perfectPlayer != NULL) {
-    uint32_t currentBoard = m_board;
-    for (int i = 0; i < 9; ++i) {
-      if (getBoardAtPosition(i) == States::empty) {
-        setBoardAtPosition(i, state);
-        moves(i) = minimax((state == States::playerX) ? state : States::playerO,
-                           turn, 0);
-        m_board = currentBoard;
-      }
-    }
-    if (state == States::playerO) {
-      moves *= -1;
-    }
-    m_board = currentBoard;
-  }
-
-  NeuralPlayer *neuralPlayer = dynamic_cast<NeuralPlayer *>(currentPlayer);
-  if (neuralPlayer != NULL) {
-    RowVectorXd cur;
-    for (int i = 0; i < 9; ++i) {
-      cur = startBoard;
-      if ((int)cur(i) == (int)States::empty) {
-        cur(i) = 1.0;
-        moves(i) = neuralPlayer->getMove(cur)(0);
-      }
+/* Writes the board that follows each legal move into consecutive rows of
+ * 'boards' starting at 'row', recording the moves in 'legalMoves'.
+ * Returns the number of rows written.
+ */
+inline int TicTacToe::afterMoveBoards(const BoardVector &startBoard,
+                                      Ref<MatrixXd> boards, const Index row,
+                                      int *legalMoves) const {
+  int numLegal = 0;
+  for (int i = 0; i < 9; ++i) {
+    if (startBoard(i) == 0.0) {
+      boards.row(row + numLegal) = startBoard;
+      boards(row + numLegal, i) = 1.0;
+      legalMoves[numLegal++] = i;
     }
   }
+  return numLegal;
 }
 
 // helper function to handle the steps required to take a turn
 inline bool TicTacToe::takeTurn(const States state, const int turn) {
+  INSTRUMENT_TIMER(TakeTurn);
   // List of desired moves in order of preference
-  RowVectorXd moves = RowVectorXd::Constant(9, 0.0);
+  BoardVector moves = BoardVector::Zero();
 
   if (m_verbose && turn == 0) {
     printBoard(moves, false);
     std::cout << "===========================================" << std::endl;
   }
 
+  // Players read the side to move from m_turn
+  m_turn = turn;
   populateMoves(state, moves, turn);
+  return playMove(state, turn, moves);
+}
 
+// Plays the best scored legal move and reports whether the game is over
+inline bool TicTacToe::playMove(const States state, const int turn,
+                                const BoardVector &moves) {
   if (m_verbose) {
     printBoard(moves, true);
   }
 
   // Make the best move from available squares
-  RowVectorXi orderedMoves = argSort(moves);
-  int move = -1;
-  for (int i = 0; i < 9; ++i) {
-    if (getBoardAtPosition(orderedMoves(i)) == States::empty) {
-      setBoardAtPosition(orderedMoves(i), state);
-      move = orderedMoves(i);
-      break;
-    }
-  }
+  uint64_t legal = legalMoves();
+  int move = MoveSelection::sample(moves.data(), &legal, NUM_ACTIONS,
+                                   m_temperature, m_random);
+  m_masks[(state == States::playerX) ? 0 : 1] |= (uint16_t)(1 << move);
+  INSTRUMENT_COUNT(MovesPlayed, 1);
 
   if (m_verbose) {
     printBoard(moves, false);
@@ -335,11 +373,13 @@ inline bool TicTacToe::takeTurn(const States state, const int turn) {
   }
 
   // Check if the move played was a winning move
-  if (turn >= 4 && hasWon(move)) {
+  if (turn >= 4 && hasWon(state)) {
     if (state == States::playerX) {
-      m_player1->fitness += winReward(turn);
+      m_result.player1Reward = winReward(turn);
+      m_result.winner = 1;
     } else {
-      m_player2->fitness += winReward(turn);
+      m_result.player2Reward = winReward(turn);
+      m_result.winner = 2;
     }
 
     if (m_verbose) {
@@ -349,19 +389,22 @@ inline bool TicTacToe::takeTurn(const States state, const int turn) {
       std::cout << "===========================================" << std::endl;
       std::cout << "===========================================" << std::endl;
     }
+    INSTRUMENT_COUNT(GamesCompleted, 1);
     return true;
   }
 
   // Check if the board is now full
   if (turn == 8 && hasTied()) {
-    m_player1->fitness += tieReward(turn);
-    m_player2->fitness += tieReward(turn);
+    m_result.player1Reward = tieReward(turn);
+    m_result.player2Reward = tieReward(turn);
+    m_result.winner = 0;
     if (m_verbose) {
       std::cout << "===========================================" << std::endl;
       std::cout << "Tie game" << std::endl;
       std::cout << "===========================================" << std::endl;
       std::cout << "===========================================" << std::endl;
     }
+    INSTRUMENT_COUNT(GamesCompleted, 1);
     return true;
   }
 
@@ -369,43 +412,4 @@ inline bool TicTacToe::takeTurn(const States state, const int turn) {
   return false;
 }
 
-inline double TicTacToe::minimax(const States state, const int turn,
-                                 int prevMove) {
-  if (turn >= 4 && hasWon(prevMove)) {
-    double score = 9.0 - turn;
-    if (state == States::playerX) {
-      return -score;
-    } else {
-      return score;
-    }
-  } else if (turn == 8 && hasTied()) {
-    return 0.0;
-  }
-
-  double bestValue;
-  if (state == States::playerX) {
-    bestValue = -1000.0;
-    uint32_t currentBoard = m_board;
-    for (int i = 0; i < 9; ++i) {
-      if (getBoardAtPosition(i) == States::empty) {
-        setBoardAtPosition(i, States::playerX);
-        bestValue = std::max(bestValue, minimax(States::playerO, turn + 1, i));
-        m_board = currentBoard;
-      }
-    }
-    return bestValue;
-  } else {
-    bestValue = 1000.0;
-    uint32_t currentBoard = m_board;
-    for (int i = 0; i < 9; ++i) {
-      if (getBoardAtPosition(i) == States::empty) {
-        setBoardAtPosition(i, States::playerO);
-        bestValue = std::min(bestValue, minimax(States::playerX, turn + 1, i));
-        m_board = currentBoard;
-      }
-    }
-    return bestValue;
-  }
-}
-
 #endif
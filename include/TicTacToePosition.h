@@ -0,0 +1,99 @@
+#ifndef TTTPOSITION_H
+#define TTTPOSITION_H
+
+#include <cstdint>
+#include "AlphaBeta.h"
+
+/* A TicTacToe board for AlphaBeta. Squares hold 0 (empty), 1 (X) or
+ * 2 (O) as in States, X moves first, and values match PerfectPlayTable:
+ * 10 - (pieces on the board) for a win, 0 for a draw. The key is the
+ * smallest base-3 index over the board's eight symmetries.
+ */
+class TicTacToePosition {
+ public:
+  static const int MAX_MOVES = 9;
+
+  TicTacToePosition() : m_pieces(0) {
+    for (int i = 0; i < 9; ++i) {
+      m_cells[i] = 0;
+    }
+  }
+
+  // Places 'player' on 'square' while setting up a position
+  void set(int square, int player) {
+    m_pieces += (m_cells[square] == 0) - (player == 0);
+    m_cells[square] = player;
+  }
+
+  int moves(int *out) const {
+    int count = 0;
+    for (int i = 0; i < 9; ++i) {
+      if (m_cells[i] == 0) {
+        out[count++] = i;
+      }
+    }
+    return count;
+  }
+
+  void play(int move) { m_cells[move] = (m_pieces++ % 2 == 0) ? 1 : 2; }
+
+  void undo(int move) {
+    m_cells[move] = 0;
+    --m_pieces;
+  }
+
+  // Only the side that just moved can have completed a line
+  bool terminal(int *value) const {
+    static const int LINES[8][3] = {{0, 1, 2}, {3, 4, 5}, {6, 7, 8},
+                                    {0, 3, 6}, {1, 4, 7}, {2, 5, 8},
+                                    {0, 4, 8}, {2, 4, 6}};
+    int previous = (m_pieces % 2 == 1) ? 1 : 2;
+    for (int i = 0; i < 8; ++i) {
+      if (m_cells[LINES[i][0]] == previous &&
+          m_cells[LINES[i][1]] == previous &&
+          m_cells[LINES[i][2]] == previous) {
+        *value = -(10 - m_pieces);
+        return true;
+      }
+    }
+    *value = 0;
+    return m_pieces == 9;
+  }
+
+  // Small enough to always be searched to the end
+  int evaluate() const { return 0; }
+
+  uint64_t key(int *symmetry) const {
+    uint64_t best = ~(uint64_t)0;
+    *symmetry = 0;
+    for (int s = 0; s < Dihedral<3>::NUM_SYMMETRIES; ++s) {
+      int transformed[9];
+      for (int i = 0; i < 9; ++i) {
+        transformed[Dihedral<3>::map(i, s)] = m_cells[i];
+      }
+      uint64_t index = 0;
+      for (int i = 0; i < 9; ++i) {
+        index = 3 * index + transformed[i];
+      }
+      if (index < best) {
+        best = index;
+        *symmetry = s;
+      }
+    }
+    return best;
+  }
+
+  static int mapMove(int move, int symmetry) {
+    return Dihedral<3>::map(move, symmetry);
+  }
+
+  static int unmapMove(int move, int symmetry) {
+    return Dihedral<3>::map(move, Dihedral<3>::inverse(symmetry));
+  }
+
+ private:
+  int m_cells[9];
+  int m_pieces;
+};
+
+#endif
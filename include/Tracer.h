@@ -0,0 +1,63 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* An optional timeline of a run, written as Chrome trace JSON for
+ * chrome://tracing or Perfetto. Each thread records its spans into its own
+ * ring buffer of fixed size, so recording takes no lock and memory stays
+ * bounded: once a buffer is full its oldest spans are overwritten. A span
+ * is kept as one complete event, begin time plus duration, so a dump never
+ * holds an end without its begin. While tracing is off a TraceScope costs
+ * one relaxed load.
+ */
+class Tracer {
+ public:
+  // Clears earlier spans and records up to 'eventsPerThread' per thread
+  static void start(size_t eventsPerThread);
+  static void stop();
+  static bool isEnabled();
+
+  // Names the calling thread in the trace, e.g. ("worker", 3)
+  static void nameThread(const char *name, int number = -1);
+
+  // Records a span from 'begin' until now. 'name' must outlive the dump,
+  // e.g. a string literal. 'arg' is shown with the span unless negative.
+  static void record(const char *name,
+                     std::chrono::steady_clock::time_point begin,
+                     int64_t arg = -1);
+
+  /* Writes every recorded span to 'path'. Only call it while no other
+   * thread is recording, e.g. between ThreadPool jobs.
+   */
+  static bool dump(const std::string &path);
+};
+
+// Records a span covering the rest of its scope while tracing is on
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name, int64_t arg = -1)
+      : m_name(Tracer::isEnabled() ? name : NULL), m_arg(arg) {
+    if (m_name != NULL) {
+      m_begin = std::chrono::steady_clock::now();
+    }
+  }
+  ~TraceScope() {
+    if (m_name != NULL) {
+      Tracer::record(m_name, m_begin, m_arg);
+    }
+  }
+
+ private:
+  TraceScope(const TraceScope &other);
+  void operator=(const TraceScope &right);
+
+  const char *m_name;
+  int64_t m_arg;
+  std::chrono::steady_clock::time_point m_begin;
+};
+
+#endif
@@ -1,531 +1,322 @@
 #ifndef ULT_H
 #define ULT_H
 
-#include <algorithm>
+#include <Eigen/Dense>
 #include <cstdint>
+#include <iomanip>
 #include <iostream>
-#include <vector>
+using namespace Eigen;
+#include "GameResult.h"
+#include "Instrumentation.h"
+#include "MoveSelection.h"
 #include "NeuralNet.h"
 #include "Player.h"
 #include "TicTacToe.h"
-
-template <class T1, class T2>
+#include "UltimateTTTPosition.h"
+
+/* Nine TicTacToe sub-boards laid out as a 3x3 meta-board. Action a is
+ * square a % 9 of sub-board a / 9, both numbered like TicTacToe squares.
+ * The square played sends the opponent to the sub-board with the same
+ * number; if that one is won or full they may play in any open sub-board.
+ * Winning a sub-board claims it on the meta-board and a line of claimed
+ * sub-boards wins the game. The first move is made in the centre. The
+ * rules themselves live in UltimateTTTPosition.
+ */
 class UltimateTTT {
  public:
-  UltimateTTT(playerContainer<T1> &player1, playerContainer<T2> &player2,
-              bool verbose = false);
-  void playGame();
-
-  // TODO: put this back into private
-  void printBoard() const;
-
-  const static int NUM_INPUTS = 9;
-  const static int NUM_OUTPUTS = 90;
+  static const int NUM_PERCEPTS = UltimateTTTPosition::NUM_PERCEPTS;
+  static const int NUM_ACTIONS = UltimateTTTPosition::NUM_ACTIONS;
+  // 64-bit words in a legal move mask
+  static const int NUM_WORDS = UltimateTTTPosition::NUM_WORDS;
+
+  typedef UltimateTTTPosition::BoardVector BoardVector;
+
+  UltimateTTT(Player *player1, Player *player2, bool verbose = false);
+  GameResult playGame();
+  void Reset();
+  /* Plays a softmax sample of each player's scores instead of the best
+   * legal move. A temperature of 0, the default, turns this off.
+   */
+  void setExploration(const double temperature, const RandomStream &random);
+
+  // Resumable play, as in TicTacToe
+  void start();
+  bool isFinished() const;
+  const NeuralPlayer *pendingPlayer() const;
+  int pendingBoards(MatrixXd &boards, const Index row) const;
+  void resume(const double *scores);
+  GameResult result() const;
+
+  // Board queries for Player::scoreMoves
+  States sideToMove() const;
+  // Sub-board the next move must be made in, or -1 for any open one
+  int activeBoard() const;
+  void legalMoves(uint64_t legal[NUM_WORDS]) const;
+  BoardVector toPlayerPerspective(const States state) const;
+  int afterMoveBoards(Ref<MatrixXd> boards, const Index row,
+                      int *legalMoves) const;
+  const UltimateTTTPosition &position() const;
 
  private:
-  bool takeTurn(const States state, const int turns);
-  bool isEmpty() const;
-  bool isFull() const;
-  bool subBoardTied(const int subBoard) const;
-
-  Matrix toMatrix() const;
-  Matrix toPlayerPerspective(const States state) const;
+  bool takeTurn(const States state, const int turn);
+  bool playMove(const States state, const int turn, const double *scores);
+  void advance();
 
-  States getBoardAtPos(const int subBoard, const int position) const;
-  States getBoardAtPos(const int i) const;
-  void setBoardAtPos(const int subBoard, const int position,
-                     const States state);
-  void setBoardAtPos(const int i, const States state);
+  void printBoard() const;
 
-  std::vector<unsigned int> bestMoves(const std::vector<double> &input) const;
-  // void printBoard() const;
-  bool boardHasWon(const uint32_t board) const;
+  double winReward(const int turn) const;
+  double tieReward(const int turn) const;
 
-  std::vector<uint32_t> m_board;
-  uint32_t m_metaBoard;
-  int activeBoard;
+  UltimateTTTPosition m_position;
 
-  playerContainer<T1> &m_player1;
-  playerContainer<T2> &m_player2;
+  Player *m_player1;
+  Player *m_player2;
 
-  bool dontRevisitSquares;
+  GameResult m_result;
+  int m_turn;
+  bool m_finished;
   bool m_verbose;
+
+  double m_temperature;
+  RandomStream m_random;
 };
 
-template <class T1, class T2>
-UltimateTTT<T1, T2>::UltimateTTT(playerContainer<T1> &player1,
-                                 playerContainer<T2> &player2, bool verbose)
-    : m_board(9, (uint32_t)0),
-      activeBoard(4),
-      m_player1(player1),
+inline UltimateTTT::UltimateTTT(Player *player1, Player *player2,
+                                bool verbose)
+    : m_player1(player1),
       m_player2(player2),
-      dontRevisitSquares(true),
-      m_verbose(verbose) {
-  m_metaBoard = (uint32_t)0;
+      m_turn(0),
+      m_finished(false),
+      m_verbose(verbose),
+      m_temperature(0.0),
+      m_random(RandomStream::get(RandomPurpose::Exploration, 0, 0)) {
+  Reset();
 }
 
-/* Plays until a player wins or the board is full.
- * Player's fitness is updated within takeTurn().
- */
-template <class T1, class T2>
-void UltimateTTT<T1, T2>::playGame() {
-  int turns = 0;
+inline void UltimateTTT::setExploration(const double temperature,
+                                        const RandomStream &random) {
+  m_temperature = temperature;
+  m_random = random;
+}
+
+// Plays until a player wins or no open sub-board is left
+inline GameResult UltimateTTT::playGame() {
+  m_result = GameResult();
+  int turn = 0;
   while (true) {
-    turns++;
-    if (takeTurn(States::playerX, turns)) {
+    if (takeTurn(States::playerX, turn)) {
       break;
     }
-    turns++;
-    if (takeTurn(States::playerO, turns)) {
+    turn++;
+    if (takeTurn(States::playerO, turn)) {
       break;
     }
+    turn++;
   }
+  return m_result;
 }
 
-// Helper method to determine if the board is empty
-template <class T1, class T2>
-bool UltimateTTT<T1, T2>::isEmpty() const {
-  for (int i = 0; i < 9; ++i) {
-    if (m_board[i] != (uint32_t)0) {
-      return false;
-    }
-  }
-  return true;
-}
-
-// Helper method to determine if the board is full
-template <class T1, class T2>
-bool UltimateTTT<T1, T2>::isFull() const {
-  for (int i = 0; i < 9; ++i) {
-    if (getBoardAtPos(-1, i) == States::empty && !subBoardTied(i)) {
-      return false;
-    }
-  }
-  return true;
-}
+inline void UltimateTTT::Reset() { m_position.reset(); }
 
-template <class T1, class T2>
-bool UltimateTTT<T1, T2>::subBoardTied(const int subBoard) const {
-  for (int i = 0; i < 9; ++i) {
-    if (getBoardAtPos(subBoard, i) == States::empty) {
-      return false;
-    }
-  }
-  return true;
+inline void UltimateTTT::start() {
+  Reset();
+  m_result = GameResult();
+  m_turn = 0;
+  m_finished = false;
+  advance();
 }
 
-// Returns a vector of the preferred moves starting with most preferred
-template <class T1, class T2>
-vector<unsigned int> UltimateTTT<T1, T2>::bestMoves(
-    const std::vector<double> &input) const {
-  std::vector<unsigned int> ret;
-  std::vector<pair<double, unsigned int>> inputPair;
-  ret.reserve(NUM_OUTPUTS);
-  inputPair.reserve(NUM_OUTPUTS);
-
-  // Populate inputPair
-  for (unsigned int i = 0; i < NUM_OUTPUTS; ++i) {
-    inputPair.push_back(make_pair(input[i], i));
-  }
-
-  sort(inputPair.begin(), inputPair.end());
+inline bool UltimateTTT::isFinished() const { return m_finished; }
 
-  // Populate temp
-  for (unsigned int i = 0; i < NUM_OUTPUTS; ++i) {
-    ret.push_back(inputPair[i].second);
-  }
+inline GameResult UltimateTTT::result() const { return m_result; }
 
-  // Reverse temp
-  reverse(ret.begin(), ret.end());
-  return ret;
+inline States UltimateTTT::sideToMove() const {
+  return (m_turn % 2 == 0) ? States::playerX : States::playerO;
 }
 
-// Prints the current board to the console
-template <class T1, class T2>
-void UltimateTTT<T1, T2>::printBoard() const {
-  for (int i = 0; i < 25; ++i) {
-    for (int j = 0; j < 47; ++j) {
-      char cur = ' ';
-
-      int x = (j - 3) / 4 - (j - 3) / 16;
-      int y = (i - 2) / 2 - (i - 2) / 8;
-
-      int subBoard = x / 3 + 3 * (int)(y / 3);
-      int subPostion = x % 3 + 3 * (y % 3);
-
-      bool insideMetaBox_x = (j / 4) % 4 == 1 || (j / 4) % 4 == 2;
-      bool insideMetaBox_y = (i / 2) % 4 == 1 || (i / 2) % 4 == 2;
-      bool metaOccupied = true;  // default
-
-      if (i != 0 && i != 24) {
-        metaOccupied = getBoardAtPos(-1, subBoard) != States::empty;
-      }
-
-      if (i % 8 == 0 && (j / 16) == (activeBoard % 3) && j % 16 != 15 &&
-          ((i / 8) == (activeBoard / 3) ||
-           (i / 8) == ((activeBoard / 3) + 1))) {
-        cur = '#';
-      } else if ((j % 16 == 0 || j % 16 == 14) &&
-                 (i / 8) == (activeBoard / 3) &&
-                 (j / 16) == (activeBoard % 3)) {
-        cur = '#';
-      } else if (i % 2 == 1 && j % 4 == 1) {
-        if (metaOccupied && dontRevisitSquares && insideMetaBox_x &&
-            insideMetaBox_y) {
-          cur = ' ';
-        } else {
-          cur = '+';
-        }
-      } else if (i % 2 == 1 && (j % 16 != 0) && (j % 16 != 14) &&
-                 (j % 16 != 15)) {
-        if (metaOccupied && dontRevisitSquares && insideMetaBox_y) {
-          cur = ' ';
-        } else {
-          cur = '-';
-        }
-      } else if (j % 4 == 1 && (i % 8 != 0)) {
-        if (metaOccupied && dontRevisitSquares && insideMetaBox_x) {
-          cur = ' ';
-        } else {
-          cur = '|';
-        }
-      } else if (i % 2 == 0 && (i % 8 != 0) && j % 4 == 3 && (j % 16 != 15)) {
-        States curState = States::empty;
-        if (metaOccupied && dontRevisitSquares) {
-          if (subPostion == 4) {
-            curState = getBoardAtPos(-1, subBoard);
-          } else {
-            curState = States::empty;
-          }
-        } else {
-          curState = getBoardAtPos(subBoard, subPostion);
-        }
-
-        if (curState == States::playerX) {
-          cur = 'X';
-        } else if (curState == States::playerO) {
-          cur = 'O';
-        } else {
-          cur = ' ';
-        }
-      }
-      cout << cur;
-    }
-    cout << endl;
+// The NeuralPlayer waiting on resume(), or NULL once the game is over
+inline const NeuralPlayer *UltimateTTT::pendingPlayer() const {
+  if (m_finished) {
+    return NULL;
   }
+  Player *current = (sideToMove() == States::playerX) ? m_player1 : m_player2;
+  return current->asNeural();
 }
 
-/* The board is stored as a 3x3 matrix.
- * This helper method converts that into a 1D column matrix
- * representation so it can be passed into other methods.
- */
-template <class T1, class T2>
-Matrix UltimateTTT<T1, T2>::toMatrix() const {
-  Matrix temp(1, NUM_OUTPUTS - 9);
-
-  for (int i = 0; i < (NUM_OUTPUTS - 9); ++i) {
-    temp(0, i) = (float)getBoardAtPos(i);
-  }
-  return temp;
+// Writes one board per legal move from 'row' on and returns how many
+inline int UltimateTTT::pendingBoards(MatrixXd &boards,
+                                      const Index row) const {
+  int legal[NUM_ACTIONS];
+  return afterMoveBoards(boards, row, legal);
 }
 
-/* Copy of the board with:
-    - player's own squares =  1,
-    - opponent's squares   = -1,
-    - empty squares        =  0
- */
-template <class T1, class T2>
-Matrix UltimateTTT<T1, T2>::toPlayerPerspective(const States state) const {
-  Matrix temp(toMatrix());
-
-  for (unsigned int i = 0; i < temp.numRows(); ++i) {
-    for (unsigned int j = 0; j < temp.numCols(); ++j) {
-      States cur = static_cast<States>(temp(i, j));
-      if (cur == States::empty) {
-        temp(i, j) = 0.0;
-      } else if (cur == state) {
-        temp(i, j) = 1.0;
-      } else {
-        temp(i, j) = -1.0;
-      }
+// 'scores' holds one value per board written by pendingBoards()
+inline void UltimateTTT::resume(const double *scores) {
+  double moves[NUM_ACTIONS] = {0.0};
+  uint64_t legal[NUM_WORDS];
+  legalMoves(legal);
+  int numLegal = 0;
+  for (int i = 0; i < NUM_ACTIONS; ++i) {
+    if ((legal[i >> 6] >> (i & 63)) & 1) {
+      moves[i] = scores[numLegal++];
     }
   }
-  return temp;
+  m_finished = playMove(sideToMove(), m_turn, moves);
+  m_turn++;
+  advance();
 }
 
-/* 'position' is an integer between [0,8], but the board is a 3x3 matrix
- * This method returns the board position at that position.
- */
-template <class T1, class T2>
-States UltimateTTT<T1, T2>::getBoardAtPos(const int subBoard,
-                                          const int position) const {
-  if (position < 0 || position > 8) {
-    cerr << "Invalid position in getBoardAtPos" << endl;
-    exit(1);
-  }
-
-  uint32_t ret;
-  if (subBoard < 0) {
-    ret = m_metaBoard;
-  } else {
-    ret = m_board[subBoard];
-  }
-
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-  ret = (uint32_t)3 & (ret >> shiftAmount);
-
-  if (ret == (uint32_t)0) {
-    return States::empty;
-  } else if (ret == (uint32_t)1) {
-    return States::playerX;
-  } else if (ret == (uint32_t)2) {
-    return States::playerO;
-  } else {
-    return States::invalid;
+// Plays turns that need no network until a NeuralPlayer is to move
+inline void UltimateTTT::advance() {
+  while (!m_finished) {
+    Player *current = (sideToMove() == States::playerX) ? m_player1 : m_player2;
+    if (current->asNeural() != NULL) {
+      return;
+    }
+    m_finished = takeTurn(sideToMove(), m_turn);
+    m_turn++;
   }
 }
 
-template <class T1, class T2>
-States UltimateTTT<T1, T2>::getBoardAtPos(const int i) const {
-  if (i < 0 || i > 81) {
-    cerr << "Invalid position in getBoardAtPos" << endl;
-    exit(1);
-  }
-
-  int x = i % 9;
-  int y = i / 9;
-
-  int subBoard = x / 3 + 3 * (int)(y / 3);
-  int position = x % 3 + 3 * (y % 3);
-
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-  uint32_t ret;
-  if (subBoard < 0) {
-    ret = m_metaBoard;
-  } else {
-    ret = m_board[subBoard];
-  }
-
-  ret = (uint32_t)3 & (ret >> shiftAmount);
-
-  if (ret == (uint32_t)0) {
-    return States::empty;
-  } else if (ret == (uint32_t)1) {
-    return States::playerX;
-  } else if (ret == (uint32_t)2) {
-    return States::playerO;
-  } else {
-    return States::invalid;
-  }
+inline int UltimateTTT::activeBoard() const {
+  return m_position.activeBoard();
 }
 
-/* This method sets the board square given by 'position' to a given value.
- */
-template <class T1, class T2>
-void UltimateTTT<T1, T2>::setBoardAtPos(const int subBoard, const int position,
-                                        const States state) {
-  if (position < 0 || position > 8) {
-    cerr << "Invalid position in getBoardAtPos" << endl;
-    exit(1);
-  }
-
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-
-  if (subBoard < 0) {
-    // Clear the 2-bit-wide field
-    m_metaBoard &= ~((uint32_t)3 << shiftAmount);
-
-    // Set the new state at the 2-bit-wide field
-    uint32_t val = (uint32_t)state;
-    m_metaBoard |= (val << shiftAmount);
-  } else {
-    // Clear the 2-bit-wide field
-    m_board[subBoard] &= ~((uint32_t)3 << shiftAmount);
-
-    // Set the new state at the 2-bit-wide field
-    uint32_t val = (uint32_t)state;
-    m_board[subBoard] |= (val << shiftAmount);
-  }
+inline const UltimateTTTPosition &UltimateTTT::position() const {
+  return m_position;
 }
 
-template <class T1, class T2>
-void UltimateTTT<T1, T2>::setBoardAtPos(const int i, const States state) {
-  if (i < 0 || i > 81) {
-    cerr << "Invalid position in getBoardAtPos" << endl;
-    exit(1);
-  }
-
-  int x = i % 9;
-  int y = i / 9;
-
-  int subBoard = x / 3 + 3 * (int)(y / 3);
-  int position = x % 3 + 3 * (y % 3);
+inline void UltimateTTT::legalMoves(uint64_t legal[NUM_WORDS]) const {
+  m_position.legalMoves(legal);
+}
 
-  uint32_t shiftAmount = (uint32_t)(8 - position) << 1;
-  // Clear the 2-bit-wode field
-  m_board[subBoard] &= ~((uint32_t)3 << shiftAmount);
+inline UltimateTTT::BoardVector UltimateTTT::toPlayerPerspective(
+    const States state) const {
+  return m_position.toPlayerPerspective(state);
+}
 
-  // Set the new state at the 2-bit-wide field
-  uint32_t val = (uint32_t)state;
-  m_board[subBoard] |= (val << shiftAmount);
+inline int UltimateTTT::afterMoveBoards(Ref<MatrixXd> boards, const Index row,
+                                        int *legalMoves) const {
+  return m_position.afterMoveBoards(boards, row, legalMoves);
 }
 
-template <class T1, class T2>
-bool UltimateTTT<T1, T2>::boardHasWon(const uint32_t board) const {
-  // PlayerX
-  if ((board & (uint32_t)65793) == (uint32_t)65793) {
-    return true;
-  }
-  if ((board & (uint32_t)4368) == (uint32_t)4368) {
-    return true;
-  }
-  if ((board & (uint32_t)86016) == (uint32_t)86016) {
-    return true;
-  }
-  if ((board & (uint32_t)1344) == (uint32_t)1344) {
-    return true;
-  }
-  if ((board & (uint32_t)21) == (uint32_t)21) {
-    return true;
-  }
-  if ((board & (uint32_t)66576) == (uint32_t)66576) {
-    return true;
-  }
-  if ((board & (uint32_t)16644) == (uint32_t)16644) {
-    return true;
-  }
-  if ((board & (uint32_t)4161) == (uint32_t)4161) {
-    return true;
-  }
+// helper function to handle the steps required to take a turn
+inline bool UltimateTTT::takeTurn(const States state, const int turn) {
+  INSTRUMENT_TIMER(TakeTurn);
+  double moves[NUM_ACTIONS] = {0.0};
 
-  // PlayerO
-  if ((board & (uint32_t)131586) == (uint32_t)131586) {
-    return true;
-  }
-  if ((board & (uint32_t)8736) == (uint32_t)8736) {
-    return true;
-  }
-  if ((board & (uint32_t)172032) == (uint32_t)172032) {
-    return true;
-  }
-  if ((board & (uint32_t)2688) == (uint32_t)2688) {
-    return true;
-  }
-  if ((board & (uint32_t)42) == (uint32_t)42) {
-    return true;
-  }
-  if ((board & (uint32_t)133152) == (uint32_t)133152) {
-    return true;
-  }
-  if ((board & (uint32_t)33288) == (uint32_t)33288) {
-    return true;
-  }
-  if ((board & (uint32_t)8322) == (uint32_t)8322) {
-    return true;
+  if (m_verbose && turn == 0) {
+    printBoard();
   }
 
-  return false;
+  // Players read the side to move from m_turn
+  m_turn = turn;
+  Player *currentPlayer = (state == States::playerX) ? m_player1 : m_player2;
+  uint64_t legal[NUM_WORDS];
+  legalMoves(legal);
+  currentPlayer->scoreMoves(*this, legal, moves);
+  return playMove(state, turn, moves);
 }
 
-// helper function to handle the steps required to take a turn
-template <class T1, class T2>
-bool UltimateTTT<T1, T2>::takeTurn(const States state, const int turn) {
-  // holds the list of desired moves in order of preference
-  std::vector<unsigned int> moves;
+// Plays the best scored legal move and reports whether the game is over
+inline bool UltimateTTT::playMove(const States state, const int turn,
+                                  const double *scores) {
+  uint64_t legal[NUM_WORDS];
+  legalMoves(legal);
+  int move = MoveSelection::sample(scores, legal, NUM_ACTIONS, m_temperature,
+                                   m_random);
+  m_position.play(move);
+  INSTRUMENT_COUNT(MovesPlayed, 1);
 
-  // Diagnostics
   if (m_verbose) {
     printBoard();
   }
 
-  // player 1 controls 'X' squares, player 2 controls 'O' squares
-  Matrix playerPerspective = toPlayerPerspective(state);
-  if (state == States::playerX) {
-    moves = bestMoves(m_player1.player.getMove(playerPerspective));
-  } else {
-    moves = bestMoves(m_player2.player.getMove(playerPerspective));
-  }
+  if (m_position.winner() != 0) {
+    if (state == States::playerX) {
+      m_result.player1Reward = winReward(turn);
+      m_result.winner = 1;
+    } else {
+      m_result.player2Reward = winReward(turn);
+      m_result.winner = 2;
+    }
 
-  // Make the best move from available squares
-  bool foundOpenSpot = false;
-  for (int i = 0; i < NUM_OUTPUTS; ++i) {
-    if (moves[i] < 9) {
-      if (getBoardAtPos(activeBoard, moves[i]) == States::empty &&
-          (getBoardAtPos(-1, activeBoard) == States::empty ||
-           !dontRevisitSquares)) {
-        setBoardAtPos(activeBoard, moves[i], state);
-        if (getBoardAtPos(-1, activeBoard) == States::empty &&
-            boardHasWon(m_board[activeBoard])) {
-          setBoardAtPos(-1, activeBoard, state);
-        }
-        activeBoard = moves[i];
-        foundOpenSpot = true;
-        break;
-      }
+    if (m_verbose) {
+      std::cout << "Player " << (state == States::playerX ? 'X' : 'O')
+                << " has won the game!" << std::endl;
+      std::cout << "=============" << std::endl;
     }
+    INSTRUMENT_COUNT(GamesCompleted, 1);
+    return true;
   }
-  if (!foundOpenSpot) {
-    for (int i = 0; i < NUM_OUTPUTS; ++i) {
-      if (moves[i] < 81) {
-        int subBoard = (moves[i] % 9) / 3 + 3 * (int)((int)(moves[i] / 9) / 3);
-        if (getBoardAtPos(moves[i]) == States::empty &&
-            (getBoardAtPos(-1, subBoard) == States::empty ||
-             !dontRevisitSquares)) {
-          setBoardAtPos(moves[i], state);
-
-          if (getBoardAtPos(-1, subBoard) == States::empty &&
-              boardHasWon(m_board[subBoard])) {
-            setBoardAtPos(-1, subBoard, state);
-          }
-          activeBoard = subBoard;
-          break;
-        }
-      }
+
+  // No open sub-board left
+  if (m_position.isFinished()) {
+    m_result.player1Reward = tieReward(turn);
+    m_result.player2Reward = tieReward(turn);
+    m_result.winner = 0;
+    if (m_verbose) {
+      std::cout << "Tie game" << std::endl;
+      std::cout << "=============" << std::endl;
     }
+    INSTRUMENT_COUNT(GamesCompleted, 1);
+    return true;
   }
 
-  // Check if the move played was a winning move
-  if (turn >= 17) {
-    if (boardHasWon(m_metaBoard)) {
-      if (state == States::playerX) {
-        m_player1.player.addToFitness(1.0 + (10.0 - turn) / 10.0);
-      } else {
-        m_player2.player.addToFitness(1.0 + (10.0 - turn) / 10.0);
-      }
+  // If the game is not over, return false
+  return false;
+}
 
-      if (m_verbose) {
-        printBoard();
+// Faster wins are worth more, as in TicTacToe
+inline double UltimateTTT::winReward(const int turn) const {
+  return 1.0 + (NUM_ACTIONS - turn) / 90.0;
+}
 
-        char symbol;
-        if (state == States::playerX) {
-          symbol = 'X';
-        } else {
-          symbol = 'O';
-        }
+inline double UltimateTTT::tieReward(const int) const { return 1.0; }
 
-        cout << "Player " << symbol << " has won the game!" << endl;
-        cout << "=============" << endl;
+/* Prints the 9x9 grid with the sub-boards boxed. Legal squares show their
+ * action number, claimed sub-boards are listed underneath.
+ */
+inline void UltimateTTT::printBoard() const {
+  uint64_t legal[NUM_WORDS];
+  legalMoves(legal);
+  const char *separator = "+----------+----------+----------+";
+
+  std::cout << separator << std::endl;
+  for (int y = 0; y < 9; ++y) {
+    std::cout << "|";
+    for (int x = 0; x < 9; ++x) {
+      int subBoard = 3 * (y / 3) + x / 3;
+      int square = 3 * (y % 3) + x % 3;
+      int action = 9 * subBoard + square;
+      States cur = m_position.getBoardAtPosition(subBoard, square);
+      if (cur == States::playerX) {
+        std::cout << "  X";
+      } else if (cur == States::playerO) {
+        std::cout << "  O";
+      } else if ((legal[action >> 6] >> (action & 63)) & 1) {
+        std::cout << std::setw(3) << action;
+      } else {
+        std::cout << "  .";
+      }
+      if (x % 3 == 2) {
+        std::cout << " |";
       }
-      return true;
+    }
+    std::cout << std::endl;
+    if (y % 3 == 2) {
+      std::cout << separator << std::endl;
     }
   }
 
-  // Check if the board is now full
-  if (turn == 81) {
-    if (isFull()) {
-      m_player1.player.addToFitness(1.0);
-      m_player2.player.addToFitness(1.0);
-      if (m_verbose) {
-        printBoard();
-        cout << "Tie game" << endl;
-        cout << "=============" << endl;
-      }
-      return true;
+  for (int b = 0; b < 9; ++b) {
+    if (m_position.isClaimed(b, States::playerX)) {
+      std::cout << "X holds sub-board " << b << std::endl;
+    } else if (m_position.isClaimed(b, States::playerO)) {
+      std::cout << "O holds sub-board " << b << std::endl;
     }
   }
-
-  // If the game is not over, return false
-  return false;
+  std::cout << std::endl;
 }
 
 #endif
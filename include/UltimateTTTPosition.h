@@ -0,0 +1,282 @@
+#ifndef ULTPOSITION_H
+#define ULTPOSITION_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+using namespace Eigen;
+#include "TicTacToe.h"
+
+/* The rules of UltimateTTT on a compact board: one 9-bit mask per side and
+ * sub-board, plus masks of the claimed and full sub-boards. Action a is
+ * square a % 9 of sub-board a / 9. Small enough to copy for every
+ * playout, which is how MonteCarloTree uses it.
+ */
+class UltimateTTTPosition {
+ public:
+  static const int NUM_PERCEPTS = 90;
+  static const int NUM_ACTIONS = 81;
+  // 64-bit words in a legal move mask
+  static const int NUM_WORDS = 2;
+
+  typedef Matrix<double, 1, NUM_PERCEPTS> BoardVector;
+
+  UltimateTTTPosition() { reset(); }
+
+  // Empty board, X to move in the centre sub-board
+  void reset() {
+    for (int b = 0; b < 9; ++b) {
+      m_boards[0][b] = 0;
+      m_boards[1][b] = 0;
+    }
+    m_meta[0] = 0;
+    m_meta[1] = 0;
+    m_full = 0;
+    m_activeBoard = 4;
+    m_side = 0;
+    m_winner = 0;
+  }
+
+  /* The position a board from toPlayerPerspective() shows, with the owner
+   * of the 1s to move. X moves first, so the side with fewer stones is O.
+   */
+  void setFromPerspective(const BoardVector &board) {
+    reset();
+    int own = 0;
+    for (int a = 0; a < NUM_ACTIONS; ++a) {
+      own += (board(a) > 0.5) - (board(a) < -0.5);
+    }
+    m_side = (own < 0) ? 1 : 0;
+    for (int b = 0; b < 9; ++b) {
+      for (int i = 0; i < 9; ++i) {
+        double square = board(9 * b + i);
+        if (square > 0.5) {
+          m_boards[m_side][b] |= (uint16_t)(1 << i);
+        } else if (square < -0.5) {
+          m_boards[1 - m_side][b] |= (uint16_t)(1 << i);
+        }
+      }
+      for (int side = 0; side < 2; ++side) {
+        if (TicTacToe::hasLine(m_boards[side][b])) {
+          m_meta[side] |= (uint16_t)(1 << b);
+        }
+      }
+      if ((m_boards[0][b] | m_boards[1][b]) == TicTacToe::FULL_BOARD &&
+          !(((m_meta[0] | m_meta[1]) >> b) & 1)) {
+        m_full |= (uint16_t)(1 << b);
+      }
+    }
+    for (int side = 0; side < 2; ++side) {
+      if (TicTacToe::hasLine(m_meta[side])) {
+        m_winner = side + 1;
+      }
+    }
+    m_activeBoard = -1;
+    for (int b = 0; b < 9; ++b) {
+      if (board(NUM_ACTIONS + b) > 0.5) {
+        m_activeBoard = b;
+      }
+    }
+  }
+
+  States sideToMove() const {
+    return (m_side == 0) ? States::playerX : States::playerO;
+  }
+
+  // Sub-board the next move must be made in, or -1 for any open one
+  int activeBoard() const { return m_activeBoard; }
+
+  // Sub-boards that are neither won nor full
+  uint16_t openBoards() const {
+    return (uint16_t)(~(m_meta[0] | m_meta[1] | m_full) &
+                      TicTacToe::FULL_BOARD);
+  }
+
+  bool isOpen(const int subBoard) const {
+    return (openBoards() >> subBoard) & 1;
+  }
+
+  // A line on the meta-board, or no open sub-board left
+  bool isFinished() const { return m_winner != 0 || openBoards() == 0; }
+
+  // 1 or 2 once X or O has won, 0 otherwise
+  int winner() const { return m_winner; }
+
+  States getBoardAtPosition(const int subBoard, const int square) const {
+    if ((m_boards[0][subBoard] >> square) & 1) {
+      return States::playerX;
+    } else if ((m_boards[1][subBoard] >> square) & 1) {
+      return States::playerO;
+    }
+    return States::empty;
+  }
+
+  bool isClaimed(const int subBoard, const States state) const {
+    return (m_meta[(state == States::playerX) ? 0 : 1] >> subBoard) & 1;
+  }
+
+  /* Sets bit 9 * b + i of 'legal' for every empty square i of the active
+   * sub-board b, or of every open sub-board on a free move.
+   */
+  void legalMoves(uint64_t legal[NUM_WORDS]) const {
+    legal[0] = 0;
+    legal[1] = 0;
+    uint16_t boards =
+        (m_activeBoard >= 0) ? (uint16_t)(1 << m_activeBoard) : openBoards();
+    for (int b = 0; b < 9; ++b) {
+      if (!((boards >> b) & 1)) {
+        continue;
+      }
+      uint64_t empty =
+          ~(m_boards[0][b] | m_boards[1][b]) & TicTacToe::FULL_BOARD;
+      int shift = 9 * b;
+      if (shift < 64) {
+        legal[0] |= empty << shift;
+        if (shift > 64 - 9) {
+          legal[1] |= empty >> (64 - shift);
+        }
+      } else {
+        legal[1] |= empty << (shift - 64);
+      }
+    }
+  }
+
+  // Plays a legal 'action' for the side to move
+  void play(const int action) {
+    int subBoard = action / 9;
+    int square = action % 9;
+    uint16_t &mine = m_boards[m_side][subBoard];
+    mine |= (uint16_t)(1 << square);
+    if (TicTacToe::hasLine(mine)) {
+      m_meta[m_side] |= (uint16_t)(1 << subBoard);
+      // Only a newly claimed sub-board can complete a meta-board line
+      if (TicTacToe::hasLine(m_meta[m_side])) {
+        m_winner = m_side + 1;
+      }
+    } else if ((mine | m_boards[1 - m_side][subBoard]) ==
+               TicTacToe::FULL_BOARD) {
+      m_full |= (uint16_t)(1 << subBoard);
+    }
+    m_activeBoard = isOpen(square) ? square : -1;
+    m_side = 1 - m_side;
+  }
+
+  /* Copy of the board with:
+      - player's own squares =  1
+      - opponent's squares   = -1
+      - empty squares        =  0
+     for the 81 actions, followed by a 1 at 81 + b if the next move must be
+     made in sub-board b.
+   */
+  BoardVector toPlayerPerspective(const States state) const {
+    int own = (state == States::playerX) ? 0 : 1;
+    BoardVector temp;
+    for (int b = 0; b < 9; ++b) {
+      for (int i = 0; i < 9; ++i) {
+        temp(9 * b + i) = (double)((m_boards[own][b] >> i) & 1) -
+                          (double)((m_boards[1 - own][b] >> i) & 1);
+      }
+    }
+    temp.tail<9>().setZero();
+    if (m_activeBoard >= 0) {
+      temp(NUM_ACTIONS + m_activeBoard) = 1.0;
+    }
+    return temp;
+  }
+
+  /* Writes the board that follows each legal move, from the mover's view,
+   * into consecutive rows of 'boards' starting at 'row', recording the
+   * moves in 'legalMoves'. The last nine columns mark where the opponent
+   * is sent. Returns the number of rows written.
+   */
+  int afterMoveBoards(Ref<MatrixXd> boards, const Index row,
+                      int *legalMoves) const {
+    BoardVector startBoard = toPlayerPerspective(sideToMove());
+    startBoard.tail<9>().setZero();
+
+    uint64_t legal[NUM_WORDS];
+    this->legalMoves(legal);
+    int numLegal = 0;
+    for (int a = 0; a < NUM_ACTIONS; ++a) {
+      if (!((legal[a >> 6] >> (a & 63)) & 1)) {
+        continue;
+      }
+      int subBoard = a / 9;
+      int square = a % 9;
+      Index r = row + numLegal;
+      boards.row(r) = startBoard;
+      boards(r, a) = 1.0;
+
+      // Playing into the sub-board we are sent to may close it
+      bool sentOpen = isOpen(square);
+      if (square == subBoard) {
+        uint16_t mine =
+            (uint16_t)(m_boards[m_side][subBoard] | (1 << square));
+        sentOpen = !TicTacToe::hasLine(mine) &&
+                   (mine | m_boards[1 - m_side][subBoard]) !=
+                       TicTacToe::FULL_BOARD;
+      }
+      if (sentOpen) {
+        boards(r, NUM_ACTIONS + square) = 1.0;
+      }
+      legalMoves[numLegal++] = a;
+    }
+    return numLegal;
+  }
+
+  // Mixes the whole position into 32 bits
+  uint32_t key() const {
+    uint64_t h = 0x9E3779B97F4A7C15ull * (uint64_t)(m_activeBoard + 2);
+    for (int b = 0; b < 9; ++b) {
+      h ^= ((uint64_t)m_boards[0][b] << 9) | m_boards[1][b];
+      h *= 0xBF58476D1CE4E5B9ull;
+      h ^= h >> 31;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+  }
+
+  static int countMoves(const uint64_t legal[NUM_WORDS]) {
+    return popCount(legal[0]) + popCount(legal[1]);
+  }
+
+  // The n-th set bit of 'legal', counting from 0
+  static int nthMove(const uint64_t legal[NUM_WORDS], int n) {
+    int word = 0;
+    int inFirst = popCount(legal[0]);
+    if (n >= inFirst) {
+      word = 1;
+      n -= inFirst;
+    }
+    uint64_t bits = legal[word];
+    for (; n > 0; --n) {
+      bits &= bits - 1;
+    }
+    return 64 * word + lowestBit(bits);
+  }
+
+ private:
+  static int popCount(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((x * 0x0101010101010101ull) >> 56);
+  }
+
+  // Index of the lowest set bit of a non-zero 'x', by de Bruijn multiply
+  static int lowestBit(uint64_t x) {
+    static const int INDEX[64] = {
+        0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6};
+    return INDEX[((x & (0 - x)) * 0x03F79D71B4CB0A89ull) >> 58];
+  }
+
+  uint16_t m_boards[2][9];
+  uint16_t m_meta[2];
+  uint16_t m_full;
+  int m_activeBoard;
+  int m_side;
+  int m_winner;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "Tracer.h"
+
+static const char CHECKPOINT_MAGIC[8] = {'T', 'T', 'T', 'C',
+                                         'H', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+static const size_t CHECKPOINT_HEADER =
+    sizeof(CHECKPOINT_MAGIC) + sizeof(CHECKPOINT_VERSION);
+
+static uint64_t checkpointChecksum(const unsigned char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+//---------------CheckpointWriter---------------
+CheckpointWriter::CheckpointWriter()
+    : m_hasPending(false), m_busy(false), m_stop(false), m_succeeded(true) {}
+
+CheckpointWriter::~CheckpointWriter() {
+  wait();
+  if (m_writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_changed.notify_all();
+    m_writer.join();
+  }
+}
+
+void CheckpointWriter::begin() { m_buffer.clear(); }
+
+void CheckpointWriter::write(const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+/* Only swaps the snapshot into the pending slot, so the caller goes
+ * straight on with training. The writer thread starts with the first
+ * commit.
+ */
+void CheckpointWriter::commit(const std::string &path) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.swap(m_buffer);
+    m_pendingPath = path;
+    m_hasPending = true;
+  }
+  m_changed.notify_all();
+  if (!m_writer.joinable()) {
+    m_writer = std::thread(&CheckpointWriter::run, this);
+  }
+}
+
+bool CheckpointWriter::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this]() { return !m_hasPending && !m_busy; });
+  return m_succeeded;
+}
+
+void CheckpointWriter::run() {
+  Tracer::nameThread("checkpoint writer");
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_changed.wait(lock, [this]() { return m_hasPending || m_stop; });
+    if (!m_hasPending) {
+      return;
+    }
+    m_writing.swap(m_pending);
+    std::string path = m_pendingPath;
+    m_hasPending = false;
+    m_busy = true;
+    lock.unlock();
+
+    bool succeeded;
+    {
+      TraceScope trace("write checkpoint");
+      succeeded = writeFile(path, m_writing);
+    }
+
+    lock.lock();
+    m_succeeded = succeeded;
+    m_busy = false;
+    m_changed.notify_all();
+  }
+}
+
+// Frames the payload with the header and its checksum as it is written
+bool CheckpointWriter::writeFile(const std::string &path,
+                                 const std::vector<unsigned char> &payload) {
+  uint64_t checksum = checkpointChecksum(payload.data(), payload.size());
+  std::string temporary = path + ".tmp";
+  std::FILE *file = std::fopen(temporary.c_str(), "wb");
+  if (file == NULL) {
+    std::cerr << "Error: Unable to create " << temporary << std::endl;
+    return false;
+  }
+  bool written =
+      std::fwrite(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC), 1, file) == 1 &&
+      std::fwrite(&CHECKPOINT_VERSION, sizeof(CHECKPOINT_VERSION), 1, file) ==
+          1 &&
+      std::fwrite(payload.data(), 1, payload.size(), file) == payload.size() &&
+      std::fwrite(&checksum, sizeof(checksum), 1, file) == 1;
+  written = (std::fclose(file) == 0) && written;
+#if defined(_WIN32)
+  // rename() does not replace an existing file here
+  if (written) {
+    std::remove(path.c_str());
+  }
+#endif
+  if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::cerr << "Error: Unable to write checkpoint " << path << std::endl;
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+//---------------CheckpointReader---------------
+CheckpointReader::CheckpointReader() : m_position(0), m_end(0) {}
+
+bool CheckpointReader::open(const std::string &path) {
+  m_position = 0;
+  m_end = 0;
+  if (!m_file.open(path)) {
+    return false;
+  }
+  const unsigned char *data = m_file.data();
+  size_t size = m_file.size();
+  uint32_t version = 0;
+  if (size >= CHECKPOINT_HEADER + sizeof(uint64_t)) {
+    std::memcpy(&version, data + sizeof(CHECKPOINT_MAGIC), sizeof(version));
+  }
+  if (version == 0 ||
+      std::memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+      version != CHECKPOINT_VERSION) {
+    std::cerr << "Error: " << path << " is not a supported checkpoint"
+              << std::endl;
+    m_file.close();
+    return false;
+  }
+
+  uint64_t checksum;
+  size_t end = size - sizeof(checksum);
+  std::memcpy(&checksum, data + end, sizeof(checksum));
+  if (checkpointChecksum(data + CHECKPOINT_HEADER, end - CHECKPOINT_HEADER) !=
+      checksum) {
+    std::cerr << "Error: Checkpoint " << path << " failed its checksum"
+              << std::endl;
+    m_file.close();
+    return false;
+  }
+  m_position = CHECKPOINT_HEADER;
+  m_end = end;
+  return true;
+}
+
+bool CheckpointReader::read(void *data, size_t size) {
+  const unsigned char *bytes = skip(size);
+  if (bytes == NULL) {
+    return false;
+  }
+  std::memcpy(data, bytes, size);
+  return true;
+}
+
+const unsigned char *CheckpointReader::skip(size_t size) {
+  if (m_end - m_position < size) {
+    return NULL;
+  }
+  const unsigned char *bytes = m_file.data() + m_position;
+  m_position += size;
+  return bytes;
+}
@@ -0,0 +1,47 @@
+#include "GenomeArena.h"
+
+#include <cstdint>
+
+GenomeArena::GenomeArena()
+    : m_front(0), m_numGenomes(0), m_genomeSize(0), m_stride(0) {
+  m_buffers[0] = NULL;
+  m_buffers[1] = NULL;
+}
+
+// Sizes both buffers for 'numGenomes' genomes of 'genomeSize' doubles
+void GenomeArena::reset(size_t numGenomes, size_t genomeSize) {
+  const size_t perLine = ALIGNMENT / sizeof(double);
+  m_numGenomes = numGenomes;
+  m_genomeSize = genomeSize;
+  m_stride = (genomeSize + perLine - 1) / perLine * perLine;
+
+  // Over-allocate by one line so the first genome can be aligned
+  size_t bufferSize = m_stride * numGenomes;
+  m_storage.assign(2 * bufferSize + perLine, 0.0);
+  uintptr_t address = (uintptr_t)m_storage.data();
+  size_t misalignment = (size_t)(address % ALIGNMENT);
+  size_t offset =
+      misalignment == 0 ? 0 : (ALIGNMENT - misalignment) / sizeof(double);
+
+  m_buffers[0] = m_storage.data() + offset;
+  m_buffers[1] = m_buffers[0] + bufferSize;
+  m_front = 0;
+}
+
+double *GenomeArena::front(size_t slot) {
+  return m_buffers[m_front] + slot * m_stride;
+}
+
+const double *GenomeArena::front(size_t slot) const {
+  return m_buffers[m_front] + slot * m_stride;
+}
+
+double *GenomeArena::back(size_t slot) {
+  return m_buffers[1 - m_front] + slot * m_stride;
+}
+
+void GenomeArena::swap() { m_front = 1 - m_front; }
+
+size_t GenomeArena::numGenomes() const { return m_numGenomes; }
+
+size_t GenomeArena::genomeSize() const { return m_genomeSize; }
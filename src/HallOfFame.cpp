@@ -0,0 +1,149 @@
+#include "HallOfFame.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// The spill file's first size, in blocks; it doubles from there
+static const size_t MIN_SPILL_BLOCKS = 16;
+
+HallOfFame::HallOfFame()
+    : m_numSpilled(0),
+      m_capacity(0),
+      m_spillFile(NULL),
+      m_spillBlocks(0),
+      m_mapping(NULL) {}
+
+HallOfFame::~HallOfFame() { clear(); }
+
+// Applies from the next add(); champions already spilled stay on disk
+void HallOfFame::setCapacity(size_t capacity, const std::string &spillPath) {
+  m_capacity = capacity;
+  if (m_spillFile == NULL) {
+    m_spillPath = spillPath;
+  }
+}
+
+bool HallOfFame::add(const NeuralPlayer &champion) {
+  m_champions.push_back(new NeuralPlayer(champion));
+  while (m_capacity > 0 && m_champions.size() - m_numSpilled > m_capacity) {
+    if (!spillOldest()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HallOfFame::clear() {
+  for (size_t i = 0; i < m_champions.size(); ++i) {
+    delete m_champions[i];
+    m_champions[i] = NULL;
+  }
+  m_champions.clear();
+  m_numSpilled = 0;
+  delete m_mapping;
+  m_mapping = NULL;
+  m_spillBlocks = 0;
+  if (m_spillFile != NULL) {
+    std::fclose(m_spillFile);
+    m_spillFile = NULL;
+    std::remove(m_spillPath.c_str());
+  }
+}
+
+size_t HallOfFame::size() const { return m_champions.size(); }
+
+size_t HallOfFame::numSpilled() const { return m_numSpilled; }
+
+Player *HallOfFame::operator[](size_t i) const { return m_champions[i]; }
+
+/* Writes the oldest in-memory champion into the next free block of the
+ * spill file and points its network at that block of the mapping. All
+ * champions share one topology, hence one block size. On failure the
+ * champion keeps its weights on the heap.
+ */
+bool HallOfFame::spillOldest() {
+  NeuralNet &net = m_champions[m_numSpilled]->neural;
+  size_t blockSize = net.numParameters();
+  if (m_numSpilled > 0 &&
+      m_champions[0]->neural.numParameters() != blockSize) {
+    std::cerr << "Error: spillOldest(): Champions differ in size."
+              << std::endl;
+    return false;
+  }
+
+  if (m_spillFile == NULL) {
+    m_spillFile = std::fopen(m_spillPath.c_str(), "w+b");
+    if (m_spillFile == NULL) {
+      std::cerr << "Error: spillOldest(): Unable to create " << m_spillPath
+                << std::endl;
+      return false;
+    }
+  }
+  if (m_numSpilled == m_spillBlocks && !growSpillFile(blockSize)) {
+    return false;
+  }
+
+  // Blocks are written in order, so the file position is this block's
+  std::fpos_t block;
+  const NeuralNet &weights = net;
+  if (std::fgetpos(m_spillFile, &block) != 0 ||
+      std::fwrite(weights.parameters(), sizeof(double), blockSize,
+                  m_spillFile) != blockSize ||
+      std::fflush(m_spillFile) != 0) {
+    std::cerr << "Error: spillOldest(): Unable to write " << m_spillPath
+              << std::endl;
+    std::clearerr(m_spillFile);
+    std::fsetpos(m_spillFile, &block);
+    return false;
+  }
+  const double *blocks = (const double *)m_mapping->data();
+  net.view(blocks + m_numSpilled * blockSize);
+  ++m_numSpilled;
+  return true;
+}
+
+/* Doubles the spill file with zeroed blocks and maps it again. The new
+ * mapping is opened before the old one is dropped, so if anything fails
+ * the spilled networks keep viewing the old one. Only here do they have to
+ * be pointed at their blocks anew.
+ */
+bool HallOfFame::growSpillFile(size_t blockSize) {
+  size_t numBlocks = std::max(MIN_SPILL_BLOCKS, 2 * m_spillBlocks);
+  std::vector<double> zeros((numBlocks - m_spillBlocks) * blockSize, 0.0);
+
+  // The file is full, so the position is both its end and the next block
+  std::fpos_t end;
+  if (std::fgetpos(m_spillFile, &end) != 0) {
+    std::cerr << "Error: growSpillFile(): Unable to seek in " << m_spillPath
+              << std::endl;
+    return false;
+  }
+  bool written = std::fwrite(zeros.data(), sizeof(double), zeros.size(),
+                             m_spillFile) == zeros.size() &&
+                 std::fflush(m_spillFile) == 0;
+  std::clearerr(m_spillFile);
+  if (std::fsetpos(m_spillFile, &end) != 0 || !written) {
+    std::cerr << "Error: growSpillFile(): Unable to write " << m_spillPath
+              << std::endl;
+    return false;
+  }
+
+  MappedFile *mapping = new MappedFile();
+  if (!mapping->open(m_spillPath) ||
+      mapping->size() < numBlocks * blockSize * sizeof(double)) {
+    std::cerr << "Error: growSpillFile(): Unable to map " << m_spillPath
+              << std::endl;
+    delete mapping;
+    return false;
+  }
+  const double *blocks = (const double *)mapping->data();
+  for (size_t i = 0; i < m_numSpilled; ++i) {
+    m_champions[i]->neural.view(blocks + i * blockSize);
+  }
+  delete m_mapping;
+  m_mapping = mapping;
+  m_spillBlocks = numBlocks;
+  return true;
+}
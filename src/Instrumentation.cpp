@@ -0,0 +1,84 @@
+#include "Instrumentation.h"
+
+#if defined(TTT_INSTRUMENT)
+
+#include <cstdio>
+#include "ThreadCounters.h"
+
+static const int NUM_COUNTERS = (int)Counter::NumCounters;
+static const int NUM_TIMERS = (int)Timer::NumTimers;
+
+static const char *COUNTER_NAMES[] = {"moves played", "games completed",
+                                      "breed allocations", "minimax nodes"};
+static const char *TIMER_NAMES[] = {"forward", "take turn", "minimax",
+                                    "cross over"};
+
+// Counters, then timer calls, then timer nanoseconds in ThreadCounters
+static int counterSlot(int counter) {
+  return ThreadCounters::FirstInstrumented + counter;
+}
+static int timerCallsSlot(int timer) {
+  return ThreadCounters::FirstInstrumented + NUM_COUNTERS + timer;
+}
+static int timerNanosecondsSlot(int timer) {
+  return ThreadCounters::FirstInstrumented + NUM_COUNTERS + NUM_TIMERS + timer;
+}
+static_assert(ThreadCounters::FirstInstrumented + NUM_COUNTERS +
+                      2 * NUM_TIMERS <=
+                  ThreadCounters::NumSlots,
+              "ThreadCounters needs more slots for Instrumentation");
+
+void Instrumentation::count(Counter counter, uint64_t amount) {
+  ThreadCounters::add(counterSlot((int)counter), amount);
+}
+
+void Instrumentation::addTime(Timer timer,
+                              std::chrono::steady_clock::duration time) {
+  ThreadCounters::add(timerCallsSlot((int)timer), 1);
+  ThreadCounters::add(
+      timerNanosecondsSlot((int)timer),
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+}
+
+uint64_t Instrumentation::total(Counter counter) {
+  return ThreadCounters::total(counterSlot((int)counter));
+}
+
+void Instrumentation::report(std::ostream &os) {
+  char line[128];
+  os << "Counters:" << std::endl;
+  std::snprintf(
+      line, sizeof(line), "  %-18s %14llu", "forward rows",
+      (unsigned long long)ThreadCounters::total(ThreadCounters::ForwardRows));
+  os << line << std::endl;
+  for (int c = 0; c < NUM_COUNTERS; ++c) {
+    std::snprintf(line, sizeof(line), "  %-18s %14llu", COUNTER_NAMES[c],
+                  (unsigned long long)ThreadCounters::total(counterSlot(c)));
+    os << line << std::endl;
+  }
+  os << "Timers:" << std::endl;
+  for (int t = 0; t < NUM_TIMERS; ++t) {
+    uint64_t calls = ThreadCounters::total(timerCallsSlot(t));
+    uint64_t nanoseconds = ThreadCounters::total(timerNanosecondsSlot(t));
+    std::snprintf(line, sizeof(line),
+                  "  %-18s %14llu calls %12.3f ms %10.1f ns/call",
+                  TIMER_NAMES[t], (unsigned long long)calls,
+                  nanoseconds / 1e6,
+                  (calls > 0) ? (double)nanoseconds / calls : 0.0);
+    os << line << std::endl;
+  }
+}
+
+// Only meant for when no instrumented code is running. Forward rows are
+// left alone, since the metrics log reads them too.
+void Instrumentation::reset() {
+  for (int c = 0; c < NUM_COUNTERS; ++c) {
+    ThreadCounters::reset(counterSlot(c));
+  }
+  for (int t = 0; t < NUM_TIMERS; ++t) {
+    ThreadCounters::reset(timerCallsSlot(t));
+    ThreadCounters::reset(timerNanosecondsSlot(t));
+  }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "MCTSPlayer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "ThreadPool.h"
+#include "UltimateTTT.h"
+
+//----------MCTSPlayer----------------
+MCTSPlayer::MCTSPlayer(const MCTSSettings &settings)
+    : Player(),
+      m_settings(settings),
+      m_pool(settings.threads > 1 ? new ThreadPool(settings.threads) : NULL) {}
+
+MCTSPlayer::MCTSPlayer(const MCTSPlayer &other)
+    : Player(other),
+      m_settings(other.m_settings),
+      m_pool(other.m_settings.threads > 1
+                 ? new ThreadPool(other.m_settings.threads)
+                 : NULL) {}
+
+MCTSPlayer::~MCTSPlayer() {
+  delete m_pool;
+  m_pool = NULL;
+}
+
+void MCTSPlayer::operator=(const MCTSPlayer &right) {
+  Player::operator=(right);
+  m_settings = right.m_settings;
+  delete m_pool;
+  m_pool = (m_settings.threads > 1) ? new ThreadPool(m_settings.threads)
+                                    : NULL;
+}
+
+const MCTSSettings &MCTSPlayer::getSettings() const { return m_settings; }
+
+RowVectorXd MCTSPlayer::getMove(const RowVectorXd &input) const {
+  if (input.size() != UltimateTTT::NUM_PERCEPTS) {
+    std::cerr << "Error: MCTSPlayer only plays UltimateTTT" << std::endl;
+    exit(1);
+  }
+  UltimateTTTPosition root;
+  root.setFromPerspective(input);
+  RowVectorXd scores = RowVectorXd::Zero(UltimateTTT::NUM_ACTIONS);
+  search(root, scores.data());
+  return scores;
+}
+
+void MCTSPlayer::scoreMoves(const UltimateTTT &game, const uint64_t *,
+                            double *scores) const {
+  search(game.position(), scores);
+}
+
+/* The playouts are split evenly between the trees. Tree t draws from the
+ * Search stream keyed by the position, so a playout-budgeted search gives
+ * the same scores whichever thread runs which tree.
+ */
+void MCTSPlayer::search(const UltimateTTTPosition &root,
+                        double *scores) const {
+  using namespace std::chrono;
+  const int numActions = UltimateTTT::NUM_ACTIONS;
+  unsigned int numTrees = std::max(1u, m_settings.threads);
+  bool timed = m_settings.seconds > 0.0;
+  unsigned int playouts = m_settings.playouts;
+  if (!timed && playouts == 0) {
+    playouts = MCTSSettings().playouts;
+  }
+  unsigned int perTree = (playouts + numTrees - 1) / numTrees;
+  steady_clock::time_point deadline =
+      steady_clock::now() +
+      duration_cast<steady_clock::duration>(
+          duration<double>(m_settings.seconds));
+  uint32_t key = root.key();
+
+  thread_local std::vector<double> treeVisits;
+  treeVisits.assign(numTrees * numActions, 0.0);
+  double *visits = treeVisits.data();
+  auto searchTrees = [&](size_t begin, size_t end, unsigned int) {
+    thread_local MonteCarloTree tree;
+    for (size_t t = begin; t < end; ++t) {
+      RandomStream random =
+          RandomStream::get(RandomPurpose::Search, key, (uint32_t)t);
+      tree.search(root, m_settings, perTree, timed, deadline, random,
+                  visits + t * numActions);
+    }
+  };
+  if (m_pool == NULL) {
+    searchTrees(0, numTrees, 0);
+  } else {
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    m_pool->parallelFor(numTrees, searchTrees);
+  }
+
+  for (unsigned int t = 0; t < numTrees; ++t) {
+    for (int a = 0; a < numActions; ++a) {
+      scores[a] += visits[t * numActions + a];
+    }
+  }
+}
@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+MappedFile::MappedFile()
+    : m_data(NULL), m_size(0), m_file(NULL), m_mapping(NULL) {}
+#else
+MappedFile::MappedFile() : m_data(NULL), m_size(0), m_fd(-1) {}
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+const unsigned char *MappedFile::data() const { return m_data; }
+
+size_t MappedFile::size() const { return m_size; }
+
+#if defined(_WIN32)
+bool MappedFile::open(const std::string &path) {
+  close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  m_file = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+  m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m_mapping == NULL) {
+    close();
+    return false;
+  }
+  m_data = (const unsigned char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0,
+                                                0, 0);
+  if (m_data == NULL) {
+    close();
+    return false;
+  }
+  m_size = (size_t)size.QuadPart;
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data != NULL) {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping != NULL) {
+    CloseHandle(m_mapping);
+  }
+  if (m_file != NULL) {
+    CloseHandle(m_file);
+  }
+  m_data = NULL;
+  m_size = 0;
+  m_mapping = NULL;
+  m_file = NULL;
+}
+#else
+bool MappedFile::open(const std::string &path) {
+  close();
+  m_fd = ::open(path.c_str(), O_RDONLY);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(m_fd, &info) != 0 || info.st_size == 0) {
+    close();
+    return false;
+  }
+  void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED) {
+    close();
+    return false;
+  }
+  m_data = (const unsigned char *)data;
+  m_size = (size_t)info.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data != NULL) {
+    munmap((void *)m_data, m_size);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+  m_data = NULL;
+  m_size = 0;
+  m_fd = -1;
+}
+#endif
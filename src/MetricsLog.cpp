@@ -0,0 +1,98 @@
+#include "MetricsLog.h"
+
+#include <algorithm>
+#include <iostream>
+
+MetricsLog::MetricsLog()
+    : m_file(NULL), m_format(MetricsFormat::JsonLines), m_stopping(false) {}
+
+MetricsLog::~MetricsLog() { close(); }
+
+bool MetricsLog::open(const std::string &path, MetricsFormat format) {
+  close();
+  m_file = std::fopen(path.c_str(), "w");
+  if (m_file == NULL) {
+    std::cerr << "Error: Unable to create metrics file " << path << std::endl;
+    return false;
+  }
+  m_format = format;
+  m_pending.clear();
+  if (m_format == MetricsFormat::Csv) {
+    m_pending =
+        "epoch,stage,generation,play_games_s,round_robin_s,sort_s,"
+        "hall_of_fame_s,breed_s,mutate_s,total_s,games,forward_passes,"
+        "games_per_s,min_fitness,median_fitness,max_fitness,hof_games,"
+        "hof_win_pct,hof_loss_pct,hof_tie_pct\n";
+  }
+  m_stopping = false;
+  m_writer = std::thread(&MetricsLog::writerLoop, this);
+  return true;
+}
+
+void MetricsLog::close() {
+  if (m_file == NULL) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_ready.notify_one();
+  m_writer.join();
+  std::fclose(m_file);
+  m_file = NULL;
+}
+
+bool MetricsLog::isOpen() const { return m_file != NULL; }
+
+void MetricsLog::write(const GenerationMetrics &m) {
+  if (m_file == NULL) {
+    return;
+  }
+  const char *layout =
+      (m_format == MetricsFormat::Csv)
+          ? "%u,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%llu,%llu,%.1f,"
+            "%.3f,%.3f,%.3f,%d,%.2f,%.2f,%.2f\n"
+          : "{\"epoch\":%u,\"stage\":%d,\"generation\":%d,"
+            "\"play_games_s\":%.6f,\"round_robin_s\":%.6f,\"sort_s\":%.6f,"
+            "\"hall_of_fame_s\":%.6f,\"breed_s\":%.6f,\"mutate_s\":%.6f,"
+            "\"total_s\":%.6f,\"games\":%llu,\"forward_passes\":%llu,"
+            "\"games_per_s\":%.1f,\"min_fitness\":%.3f,"
+            "\"median_fitness\":%.3f,\"max_fitness\":%.3f,"
+            "\"hof_games\":%d,\"hof_win_pct\":%.2f,\"hof_loss_pct\":%.2f,"
+            "\"hof_tie_pct\":%.2f}\n";
+  char record[1024];
+  int length = std::snprintf(
+      record, sizeof(record), layout, m.epoch, m.stage, m.generation,
+      m.playGamesSeconds, m.roundRobinSeconds, m.sortSeconds,
+      m.hallOfFameSeconds, m.breedSeconds, m.mutateSeconds, m.totalSeconds,
+      (unsigned long long)m.games, (unsigned long long)m.forwardPasses,
+      m.gamesPerSecond, m.minFitness, m.medianFitness, m.maxFitness,
+      m.hallOfFameGames, m.winPercent, m.lossPercent, m.tiePercent);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.append(record, std::min<size_t>(length, sizeof(record) - 1));
+  }
+  m_ready.notify_one();
+}
+
+// Swaps out everything pending and writes it without holding the lock
+void MetricsLog::writerLoop() {
+  std::string writing;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_ready.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+    writing.swap(m_pending);
+    bool stopping = m_stopping;
+    lock.unlock();
+    if (!writing.empty()) {
+      std::fwrite(writing.data(), 1, writing.size(), m_file);
+      std::fflush(m_file);
+      writing.clear();
+    }
+    lock.lock();
+    if (stopping && m_pending.empty()) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,185 @@
+#include "MonteCarloTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include "UltimateTTTPosition.h"
+
+MonteCarloTree::MonteCarloTree()
+    : m_boards(UltimateTTTPosition::NUM_ACTIONS,
+               UltimateTTTPosition::NUM_PERCEPTS) {}
+
+size_t MonteCarloTree::numNodes() const { return m_nodes.size(); }
+
+unsigned int MonteCarloTree::search(
+    const UltimateTTTPosition &root, const MCTSSettings &settings,
+    unsigned int playouts, bool timed,
+    std::chrono::steady_clock::time_point deadline, RandomStream &random,
+    double *visits) {
+  m_nodes.clear();
+  Node rootNode = {-1, 0, 0.0f, 1.0f, 0.0f, 0, 0};
+  m_nodes.push_back(rootNode);
+
+  // The side to move at depth d is rootSide ^ (d & 1)
+  const int rootSide = (root.sideToMove() == States::playerX) ? 0 : 1;
+  int path[UltimateTTTPosition::NUM_ACTIONS + 1];
+
+  unsigned int iterations = 0;
+  while (playouts == 0 || iterations < playouts) {
+    if (timed && (iterations & 63) == 0 &&
+        std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    ++iterations;
+
+    // Select
+    UltimateTTTPosition position = root;
+    int node = 0;
+    int depth = 0;
+    path[0] = 0;
+    while (m_nodes[node].firstChild >= 0 && !position.isFinished()) {
+      node = selectChild(node, settings);
+      position.play(m_nodes[node].action);
+      path[++depth] = node;
+    }
+
+    // Expand a leaf seen before and step into one of its children
+    if (!position.isFinished() && (node == 0 || m_nodes[node].visits > 0) &&
+        expand(node, position, settings)) {
+      node = selectChild(node, settings);
+      position.play(m_nodes[node].action);
+      path[++depth] = node;
+    }
+
+    // Evaluate, from X's point of view
+    float result;
+    if (position.isFinished()) {
+      int winner = position.winner();
+      result = (winner == 1) ? 1.0f : (winner == 2) ? -1.0f : 0.0f;
+    } else if (settings.network != NULL && settings.networkValue &&
+               depth > 0) {
+      bool xMoved = (rootSide ^ ((depth - 1) & 1)) == 0;
+      result = xMoved ? m_nodes[node].networkValue
+                      : -m_nodes[node].networkValue;
+    } else {
+      result = (float)playout(position, random);
+    }
+
+    // Back up
+    m_nodes[0].visits++;
+    for (int d = depth; d > 0; --d) {
+      Node &current = m_nodes[path[d]];
+      bool xMoved = (rootSide ^ ((d - 1) & 1)) == 0;
+      current.visits++;
+      current.value += xMoved ? result : -result;
+    }
+  }
+
+  const Node &top = m_nodes[0];
+  for (int c = 0; c < top.numChildren; ++c) {
+    const Node &child = m_nodes[top.firstChild + c];
+    visits[child.action] += child.visits;
+  }
+  return iterations;
+}
+
+/* Adds a child per legal move, with priors from the network if there is
+ * one. Returns false if the position has no moves or the tree is full.
+ */
+bool MonteCarloTree::expand(int node, const UltimateTTTPosition &position,
+                            const MCTSSettings &settings) {
+  uint64_t legal[UltimateTTTPosition::NUM_WORDS];
+  position.legalMoves(legal);
+  int numLegal = UltimateTTTPosition::countMoves(legal);
+  if (numLegal == 0 || m_nodes.size() + numLegal > settings.maxNodes) {
+    return false;
+  }
+
+  int32_t first = (int32_t)m_nodes.size();
+  if (settings.network != NULL) {
+    int actions[UltimateTTTPosition::NUM_ACTIONS];
+    position.afterMoveBoards(m_boards, 0, actions);
+    NeuralNet::ConstBatch scores = settings.network->forwardBatch(
+        m_boards.topRows(numLegal), NeuralNet::threadWorkspace());
+
+    double max = scores.col(0).maxCoeff();
+    double sum = 0.0;
+    for (int k = 0; k < numLegal; ++k) {
+      sum += std::exp((scores(k, 0) - max) / settings.priorTemperature);
+    }
+    for (int k = 0; k < numLegal; ++k) {
+      double prior =
+          std::exp((scores(k, 0) - max) / settings.priorTemperature) / sum;
+      // Sigmoid outputs map to [-1, 1] like playout results
+      Node child = {-1,
+                    0,
+                    0.0f,
+                    (float)prior,
+                    (float)(2.0 * scores(k, 0) - 1.0),
+                    (uint8_t)actions[k],
+                    0};
+      m_nodes.push_back(child);
+    }
+  } else {
+    float prior = 1.0f / numLegal;
+    for (int a = 0; a < UltimateTTTPosition::NUM_ACTIONS; ++a) {
+      if ((legal[a >> 6] >> (a & 63)) & 1) {
+        Node child = {-1, 0, 0.0f, prior, 0.0f, (uint8_t)a, 0};
+        m_nodes.push_back(child);
+      }
+    }
+  }
+  m_nodes[node].firstChild = first;
+  m_nodes[node].numChildren = (uint8_t)numLegal;
+  return true;
+}
+
+/* UCT: unvisited children first, then the best mean result plus
+ * exploration * sqrt(ln N / n). With network priors this becomes PUCT,
+ * mean + exploration * prior * sqrt(N) / (1 + n), where unvisited children
+ * count as their network value if it is used and as a draw otherwise.
+ */
+int MonteCarloTree::selectChild(int node,
+                                const MCTSSettings &settings) const {
+  const Node &parent = m_nodes[node];
+  bool guided = settings.network != NULL;
+  double logVisits = std::log((double)std::max<uint32_t>(parent.visits, 1));
+  double sqrtVisits = std::sqrt((double)std::max<uint32_t>(parent.visits, 1));
+
+  int best = parent.firstChild;
+  double bestScore = -HUGE_VAL;
+  for (int c = 0; c < parent.numChildren; ++c) {
+    int index = parent.firstChild + c;
+    const Node &child = m_nodes[index];
+    double score;
+    if (guided) {
+      double mean = (child.visits > 0)     ? child.value / child.visits
+                    : settings.networkValue ? child.networkValue
+                                            : 0.0;
+      score = mean + settings.exploration * child.prior * sqrtVisits /
+                         (1.0 + child.visits);
+    } else {
+      if (child.visits == 0) {
+        return index;
+      }
+      score = child.value / child.visits +
+              settings.exploration * std::sqrt(logVisits / child.visits);
+    }
+    if (score > bestScore) {
+      bestScore = score;
+      best = index;
+    }
+  }
+  return best;
+}
+
+int MonteCarloTree::playout(UltimateTTTPosition position,
+                            RandomStream &random) {
+  uint64_t legal[UltimateTTTPosition::NUM_WORDS];
+  while (!position.isFinished()) {
+    position.legalMoves(legal);
+    int numLegal = UltimateTTTPosition::countMoves(legal);
+    position.play(UltimateTTTPosition::nthMove(legal, random.below(numLegal)));
+  }
+  int winner = position.winner();
+  return (winner == 1) ? 1 : (winner == 2) ? -1 : 0;
+}
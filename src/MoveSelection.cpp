@@ -0,0 +1,104 @@
+#include "MoveSelection.h"
+
+#include <cmath>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static inline bool isLegal(const uint64_t *legal, size_t i) {
+  return (legal[i >> 6] >> (i & 63)) & 1;
+}
+
+#if defined(__AVX2__)
+// All ones in lane k if action i + k is legal; 'i' is a multiple of 4
+static inline __m256d legalLanes(const uint64_t *legal, size_t i) {
+  const __m256i lanes = _mm256_set_epi64x(8, 4, 2, 1);
+  uint64_t bits = (legal[i >> 6] >> (i & 63)) & 0xF;
+  __m256i set = _mm256_and_si256(_mm256_set1_epi64x((long long)bits), lanes);
+  return _mm256_castsi256_pd(_mm256_cmpeq_epi64(set, lanes));
+}
+
+static inline double horizontalMax4(__m256d v) {
+  __m128d m = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  m = _mm_max_sd(m, _mm_unpackhi_pd(m, m));
+  return _mm_cvtsd_f64(m);
+}
+#endif
+
+bool MoveSelection::usesAvx2() {
+#if defined(__AVX2__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int MoveSelection::argmax(const double *scores, const uint64_t *legal,
+                          size_t count) {
+  double best = -HUGE_VAL;
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256d lowest = _mm256_set1_pd(-HUGE_VAL);
+  __m256d best4 = lowest;
+  for (; i + 4 <= count; i += 4) {
+    // NaN lanes are dropped like illegal ones, as the scalar compare does
+    __m256d x = _mm256_loadu_pd(scores + i);
+    __m256d keep = _mm256_and_pd(legalLanes(legal, i),
+                                 _mm256_cmp_pd(x, x, _CMP_ORD_Q));
+    x = _mm256_blendv_pd(lowest, x, keep);
+    best4 = _mm256_max_pd(best4, x);
+  }
+  best = horizontalMax4(best4);
+#endif
+  for (; i < count; ++i) {
+    if (isLegal(legal, i) && scores[i] > best) {
+      best = scores[i];
+    }
+  }
+
+  // The best value is known, find the last legal action that has it
+  int lastLegal = -1;
+  for (size_t j = count; j-- > 0;) {
+    if (isLegal(legal, j)) {
+      if (scores[j] == best) {
+        return (int)j;
+      }
+      if (lastLegal < 0) {
+        lastLegal = (int)j;
+      }
+    }
+  }
+  return lastLegal;
+}
+
+// Softmax over the legal actions, drawn by walking the running sum
+int MoveSelection::sample(const double *scores, const uint64_t *legal,
+                          size_t count, double temperature,
+                          RandomStream &random) {
+  int best = argmax(scores, legal, count);
+  if (temperature <= 0.0) {
+    return best;
+  }
+
+  const double max = scores[best];
+  double sum = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    if (isLegal(legal, i)) {
+      sum += std::exp((scores[i] - max) / temperature);
+    }
+  }
+
+  double target = random.uniform() * sum;
+  int last = best;
+  for (size_t i = 0; i < count; ++i) {
+    if (isLegal(legal, i)) {
+      target -= std::exp((scores[i] - max) / temperature);
+      if (target < 0.0) {
+        return (int)i;
+      }
+      last = (int)i;
+    }
+  }
+  // Rounding left a sliver of the sum
+  return last;
+}
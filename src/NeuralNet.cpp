@@ -1,45 +1,175 @@
 
 #include "NeuralNet.h"
 
-NeuralNet::NeuralNet() {}
+#include <cstring>
+#include "Instrumentation.h"
+#include "SimdActivations.h"
+#include "ThreadCounters.h"
 
-// Constructor takes in the structure of the network as a matrix
-NeuralNet::NeuralNet(const std::vector<unsigned int> &layerSizes)
-    : m_layerSizes(layerSizes) {
-  unsigned int numLayers = layerSizes.size() - 1;
-  m_weights.reserve(numLayers);
+// Binary model header, see ModelFormat
+struct ModelHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t dataType;
+  uint32_t numLayers;
+  uint32_t headerSize;
+  uint64_t numParameters;
+  uint64_t checksum;
+  unsigned char reserved[24];
+};
+static_assert(sizeof(ModelHeader) == 64, "ModelHeader must be 64 bytes");
 
-  // Create vectors for weights. Each entry is a matrix for that layer
-  for (unsigned int i = 0; i < numLayers; ++i) {
-    m_weights.push_back(MatrixXd::Random(layerSizes[i] + 1, layerSizes[i + 1]));
+static const char MODEL_MAGIC[8] = {'T', 'T', 'T', 'M', 'O', 'D', 'E', 'L'};
+static const uint32_t MODEL_VERSION = 1;
+static const uint32_t MODEL_FLOAT64 = 1;
+static const size_t MODEL_ALIGNMENT = 64;
+
+// FNV-1a over the layer sizes and the weights' bit patterns, a word at a time
+static uint64_t modelChecksum(const std::vector<unsigned int> &layerSizes,
+                              const double *weights, size_t count) {
+  const uint64_t prime = 1099511628211ull;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < layerSizes.size(); ++i) {
+    hash = (hash ^ layerSizes[i]) * prime;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t bits;
+    std::memcpy(&bits, weights + i, sizeof(bits));
+    hash = (hash ^ bits) * prime;
+  }
+  return hash;
+}
+
+NeuralNet::NeuralNet()
+    : m_arena(NULL),
+      m_slot(0),
+      m_view(NULL),
+      m_mapping(NULL),
+      m_kernel(NULL),
+      m_precision(Precision::Double),
+      m_floatStale(true) {
+  m_layerOffsets.push_back(0);
+}
+
+// Constructor takes in the structure of the network as a matrix. The
+// weights start uniform in [-1, 1), drawn from 'random'.
+NeuralNet::NeuralNet(const std::vector<unsigned int> &layerSizes,
+                     RandomStream &random)
+    : m_arena(NULL),
+      m_slot(0),
+      m_view(NULL),
+      m_mapping(NULL),
+      m_kernel(NULL),
+      m_precision(Precision::Double),
+      m_floatStale(true) {
+  setLayerSizes(layerSizes);
+
+  // Layers are drawn in order, column by column, as they are laid out
+  m_ownedParameters.resize(m_layerOffsets.back());
+  for (Index i = 0; i < m_ownedParameters.size(); ++i) {
+    m_ownedParameters[i] = 2.0 * random.uniform() - 1.0;
   }
 }
 
+// Copies are always owned, even when 'nn' lives in an arena
 NeuralNet::NeuralNet(const NeuralNet &nn)
-    : m_layerSizes(nn.m_layerSizes), m_weights(nn.m_weights) {}
+    : m_layerSizes(nn.m_layerSizes),
+      m_layerOffsets(nn.m_layerOffsets),
+      m_ownedParameters(
+          Map<const VectorXd>(nn.parameters(), nn.numParameters())),
+      m_arena(NULL),
+      m_slot(0),
+      m_view(NULL),
+      m_mapping(NULL),
+      m_kernel(nn.m_kernel),
+      m_precision(nn.m_precision),
+      m_floatParameters(nn.m_floatParameters),
+      m_floatStale(nn.m_floatStale) {}
+
+NeuralNet::~NeuralNet() { releaseMapping(); }
 
+// Copies the weights of 'nn' into this network's own storage, which stays
+// in its arena slot if bound and the topologies match
 void NeuralNet::operator=(const NeuralNet &nn) {
+  if (this == &nn) {
+    return;
+  }
+  if (m_arena != NULL && nn.numParameters() != numParameters()) {
+    m_arena = NULL;
+  }
+  m_view = NULL;
+  releaseMapping();
   m_layerSizes = nn.m_layerSizes;
-  m_weights = nn.m_weights;
+  m_layerOffsets = nn.m_layerOffsets;
+  if (m_arena != NULL) {
+    std::copy(nn.parameters(), nn.parameters() + numParameters(),
+              parameters());
+  } else {
+    m_ownedParameters =
+        Map<const VectorXd>(nn.parameters(), nn.numParameters());
+  }
+  m_kernel = nn.m_kernel;
+  m_precision = nn.m_precision;
+  m_floatParameters = nn.m_floatParameters;
+  m_floatStale = nn.m_floatStale;
+}
+
+void NeuralNet::setLayerSizes(const std::vector<unsigned int> &layerSizes) {
+  m_layerSizes = layerSizes;
+  m_layerOffsets.assign(1, 0);
+  for (unsigned int i = 0; i + 1 < layerSizes.size(); ++i) {
+    size_t layerSize = (size_t)(layerSizes[i] + 1) * layerSizes[i + 1];
+    m_layerOffsets.push_back(m_layerOffsets.back() + layerSize);
+  }
 }
 
 // Prints the current weights to the console
 void NeuralNet::printWeights() const {
   std::cout << "Current weights:" << std::endl;
-  for (unsigned int i = 0; i < m_weights.size(); ++i) {
+  for (unsigned int i = 0; i < numLayers(); ++i) {
     std::cout << "================================================"
               << std::endl;
-    std::cout << m_weights[i] << std::endl;
+    std::cout << layer(i) << std::endl;
   }
   std::cout << "================================================" << std::endl;
 }
 
-bool NeuralNet::saveToFile(std::string fileName) const {
+bool NeuralNet::saveToFile(std::string fileName, ModelFormat format) const {
   std::ofstream outputFile;
-  outputFile.open(fileName.c_str());
+  if (format == ModelFormat::Binary) {
+    outputFile.open(fileName.c_str(), std::ios::binary);
+  } else {
+    outputFile.open(fileName.c_str());
+  }
   if (!outputFile.is_open()) {
     return false;
   }
+  const double *params = parameters();
+
+  if (format == ModelFormat::Binary) {
+    ModelHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.dataType = MODEL_FLOAT64;
+    header.numLayers = (uint32_t)m_layerSizes.size();
+    size_t used = sizeof(header) + sizeof(uint32_t) * m_layerSizes.size();
+    header.headerSize = (uint32_t)((used + MODEL_ALIGNMENT - 1) /
+                                   MODEL_ALIGNMENT * MODEL_ALIGNMENT);
+    header.numParameters = numParameters();
+    header.checksum = modelChecksum(m_layerSizes, params, numParameters());
+
+    std::vector<unsigned char> block(header.headerSize, 0);
+    std::memcpy(block.data(), &header, sizeof(header));
+    for (size_t i = 0; i < m_layerSizes.size(); ++i) {
+      uint32_t size = m_layerSizes[i];
+      std::memcpy(block.data() + sizeof(header) + i * sizeof(size), &size,
+                  sizeof(size));
+    }
+    outputFile.write((const char *)block.data(), block.size());
+    outputFile.write((const char *)params, numParameters() * sizeof(double));
+    return outputFile.good();
+  }
 
   // Outuput number of layer
   outputFile << m_layerSizes.size() << "\n";
@@ -50,15 +180,9 @@ bool NeuralNet::saveToFile(std::string fileName) const {
   }
   outputFile << "\n";
 
-  for (unsigned int lay = 0; lay < m_weights.size(); ++lay) {
-    unsigned int rows = m_weights[lay].rows();
-    unsigned int cols = m_weights[lay].cols();
-
-    for (unsigned int col = 0; col < cols; ++col) {
-      for (unsigned int row = 0; row < rows; ++row) {
-        outputFile << m_weights[lay](row, col) << " ";
-      }
-    }
+  // The parameters are stored in file order already
+  for (size_t i = 0; i < numParameters(); ++i) {
+    outputFile << params[i] << " ";
   }
 
   outputFile << "D\n";
@@ -66,35 +190,159 @@ bool NeuralNet::saveToFile(std::string fileName) const {
   return true;
 }
 
+/* Binary models are recognised by their magic, anything else is read as
+ * text. Either way the network owns the loaded weights.
+ */
 bool NeuralNet::loadFromFile(std::string fileName) {
   std::ifstream inputFile;
-  inputFile.open(fileName.c_str());
+  inputFile.open(fileName.c_str(), std::ios::binary);
   if (!inputFile.is_open()) {
     return false;
   }
 
+  char magic[sizeof(MODEL_MAGIC)] = {0};
+  inputFile.read(magic, sizeof(magic));
+  if (std::memcmp(magic, MODEL_MAGIC, sizeof(magic)) != 0) {
+    inputFile.clear();
+    inputFile.seekg(0);
+    return loadText(inputFile);
+  }
+
+  inputFile.seekg(0, std::ios::end);
+  std::streamoff fileSize = inputFile.tellg();
+  if (fileSize < 0) {
+    std::cerr << "Error: Unable to read " << fileName << std::endl;
+    return false;
+  }
+  std::vector<unsigned char> contents((size_t)fileSize);
+  inputFile.seekg(0);
+  if (!inputFile.read((char *)contents.data(), contents.size())) {
+    std::cerr << "Error: Unable to read " << fileName << std::endl;
+    return false;
+  }
+  std::vector<unsigned int> layerSizes;
+  const double *weights =
+      parseBinary(contents.data(), contents.size(), layerSizes);
+  if (weights == NULL) {
+    return false;
+  }
+
+  // A kernel is only valid for the topology it was attached to
+  m_kernel = NULL;
+  m_floatStale = true;
+  setLayerSizes(layerSizes);
+  m_arena = NULL;
+  m_view = NULL;
+  releaseMapping();
+  m_ownedParameters = Map<const VectorXd>(weights, numParameters());
+  return true;
+}
+
+/* The weights stay in the mapped file, so loading costs no copy and the
+ * pages are only read as inference touches them. Text models cannot be
+ * mapped; use loadFromFile for those.
+ */
+bool NeuralNet::mapFromFile(std::string fileName) {
+  MappedFile *mapping = new MappedFile();
+  std::vector<unsigned int> layerSizes;
+  const double *weights = NULL;
+  // Text models are left to loadFromFile without an error
+  if (mapping->open(fileName) && mapping->size() >= sizeof(MODEL_MAGIC) &&
+      std::memcmp(mapping->data(), MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0) {
+    weights = parseBinary(mapping->data(), mapping->size(), layerSizes);
+  }
+  if (weights == NULL) {
+    delete mapping;
+    return false;
+  }
+
+  m_kernel = NULL;
+  setLayerSizes(layerSizes);
+  view(weights);
+  m_mapping = mapping;
+  return true;
+}
+
+void NeuralNet::releaseMapping() {
+  delete m_mapping;
+  m_mapping = NULL;
+}
+
+const double *NeuralNet::parseBinary(
+    const unsigned char *data, size_t size,
+    std::vector<unsigned int> &layerSizes) const {
+  ModelHeader header;
+  if (size < sizeof(header)) {
+    std::cerr << "Error: Model file is truncated" << std::endl;
+    return NULL;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  // A network needs an input and an output layer
+  if (std::memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != MODEL_VERSION || header.dataType != MODEL_FLOAT64 ||
+      header.numLayers < 2) {
+    std::cerr << "Error: Model file has an unsupported format or version"
+              << std::endl;
+    return NULL;
+  }
+  if (header.headerSize % MODEL_ALIGNMENT != 0 ||
+      header.headerSize <
+          sizeof(header) + sizeof(uint32_t) * (size_t)header.numLayers ||
+      size < header.headerSize ||
+      (size - header.headerSize) / sizeof(double) < header.numParameters) {
+    std::cerr << "Error: Model file is truncated" << std::endl;
+    return NULL;
+  }
+
+  layerSizes.resize(header.numLayers);
+  size_t expected = 0;
+  for (uint32_t i = 0; i < header.numLayers; ++i) {
+    uint32_t layerSize;
+    std::memcpy(&layerSize, data + sizeof(header) + i * sizeof(layerSize),
+                sizeof(layerSize));
+    if (layerSize == 0) {
+      std::cerr << "Error: Model file has an unsupported format or version"
+                << std::endl;
+      return NULL;
+    }
+    layerSizes[i] = layerSize;
+    if (i > 0) {
+      expected += ((size_t)layerSizes[i - 1] + 1) * layerSize;
+    }
+  }
+  const double *weights = (const double *)(data + header.headerSize);
+  if (expected != header.numParameters ||
+      modelChecksum(layerSizes, weights, expected) != header.checksum) {
+    std::cerr << "Error: Model file failed its checksum" << std::endl;
+    return NULL;
+  }
+  return weights;
+}
+
+// The original text format, see ModelFormat
+bool NeuralNet::loadText(std::ifstream &inputFile) {
   unsigned int numLayers;
   inputFile >> numLayers;
 
-  m_layerSizes.clear();
+  // A kernel is only valid for the topology it was attached to
+  m_kernel = NULL;
+  m_floatStale = true;
+
+  std::vector<unsigned int> layerSizes;
   for (unsigned int i = 0; i < numLayers; ++i) {
     unsigned int cur;
     inputFile >> cur;
-    m_layerSizes.push_back(cur);
-  }
-
-  for (unsigned int lay = 0; lay < numLayers - 1; ++lay) {
-    unsigned int rows = m_layerSizes[lay] + 1;
-    unsigned int cols = m_layerSizes[lay + 1];
-    MatrixXd cur(rows, cols);
-    for (unsigned int col = 0; col < cols; ++col) {
-      for (unsigned int row = 0; row < rows; ++row) {
-        double temp;
-        inputFile >> temp;
-        cur(row, col) = temp;
-      }
-    }
-    m_weights.push_back(cur);
+    layerSizes.push_back(cur);
+  }
+  setLayerSizes(layerSizes);
+
+  // The loaded network may not fit the arena, so it owns its weights
+  m_arena = NULL;
+  m_view = NULL;
+  releaseMapping();
+  m_ownedParameters.resize(m_layerOffsets.back());
+  for (Index i = 0; i < m_ownedParameters.size(); ++i) {
+    inputFile >> m_ownedParameters[i];
   }
 
   char check;
@@ -109,39 +357,229 @@ bool NeuralNet::loadFromFile(std::string fileName) {
   return true;
 }
 
-// Performs forward propagation using m_weights and 'input'
-RowVectorXd NeuralNet::forward(const RowVectorXd &input) const {
-  unsigned int numLayers = m_weights.size();
+/* Performs forward propagation using the weights and 'input'. The input
+ * is mapped as a one-row matrix rather than copied, and the result points
+ * into the thread's workspace, so a single row costs no allocation either.
+ * It is only valid until the workspace is used again.
+ */
+NeuralNet::ConstRow NeuralNet::forward(
+    const Ref<const RowVectorXd, 0, InnerStride<>> &input) const {
+  Map<const MatrixXd, 0, OuterStride<>> row(
+      input.data(), 1, input.size(), OuterStride<>(input.innerStride()));
+  ConstBatch batch = forwardBatch(row, threadWorkspace());
+  return ConstRow(batch.nestedExpression(), batch.startRow(),
+                  batch.startCol(), 1, batch.cols());
+}
+
+MatrixXd NeuralNet::forwardBatch(const MatrixXd &inputs) const {
+  return forwardBatch(inputs, threadWorkspace());
+}
+
+/* Forward propagates every row of 'inputs' in one matrix product per layer.
+ * The last row of each weight matrix is the bias, so it is added to each row
+ * of the product instead of appending a column of ones to the input. Layer
+ * outputs live in 'workspace' and the returned block points into it, so it
+ * is only valid until the workspace is used again.
+ */
+NeuralNet::ConstBatch NeuralNet::forwardBatch(const Ref<const MatrixXd> &inputs,
+                                              Workspace &workspace) const {
+  INSTRUMENT_TIMER(Forward);
+  unsigned int numLayers = this->numLayers();
+  Index numRows = inputs.rows();
+  ThreadCounters::add(ThreadCounters::ForwardRows, numRows);
+  if (workspace.layers.size() < numLayers) {
+    workspace.layers.resize(numLayers);
+  }
+
+  if (m_precision == Precision::Float && !m_floatStale) {
+    return forwardBatchFloat(inputs, workspace);
+  }
+
+  if (m_kernel != NULL) {
+    MatrixXd &output = workspace.layers[numLayers - 1];
+    Index numOutputs = m_layerSizes.back();
+    if (output.rows() < numRows || output.cols() != numOutputs) {
+      output.resize(std::max(numRows, output.rows()), numOutputs);
+    }
+    m_kernel(parameters(), inputs, output.topRows(numRows));
+    const MatrixXd &result = output;
+    return result.topRows(numRows);
+  }
+
+  for (unsigned int lay = 0; lay < numLayers; ++lay) {
+    Map<const MatrixXd> weights = layer(lay);
+    Index numInputs = weights.rows() - 1;
+
+    // Buffers only grow, so a steady batch size never reallocates
+    MatrixXd &buffer = workspace.layers[lay];
+    if (buffer.rows() < numRows || buffer.cols() != weights.cols()) {
+      buffer.resize(std::max(numRows, buffer.rows()), weights.cols());
+    }
+
+    Block<MatrixXd> next = buffer.topRows(numRows);
+    if (lay == 0) {
+      next.noalias() = inputs * weights.topRows(numInputs);
+    } else {
+      next.noalias() = workspace.layers[lay - 1].topRows(numRows) *
+                       weights.topRows(numInputs);
+    }
+    next.rowwise() += weights.row(numInputs);
+    applyNonlinearityRows(next, Activations::sigmoid);
+  }
+  const MatrixXd &output = workspace.layers[numLayers - 1];
+  return output.topRows(numRows);
+}
 
-  // Stores the previous layer's output
-  std::vector<RowVectorXd> layers;
-  layers.reserve(numLayers + 1);
-  layers.push_back(input);
+// Same as forwardBatch but in single precision with the SIMD activations.
+// The outputs are widened back to doubles in the last double buffer.
+NeuralNet::ConstBatch NeuralNet::forwardBatchFloat(
+    const Ref<const MatrixXd> &inputs, Workspace &workspace) const {
+  unsigned int numLayers = this->numLayers();
+  Index numRows = inputs.rows();
+  if (workspace.floatLayers.size() < numLayers) {
+    workspace.floatLayers.resize(numLayers);
+  }
+
+  RowMatrixXf &input = workspace.floatInput;
+  if (input.rows() < numRows || input.cols() != inputs.cols()) {
+    input.resize(std::max(numRows, input.rows()), inputs.cols());
+  }
+  input.topRows(numRows) = inputs.cast<float>();
 
   for (unsigned int lay = 0; lay < numLayers; ++lay) {
-    unsigned int numCols = layers[lay].cols();
-    layers[lay].conservativeResize(NoChange, numCols + 1);
-    layers[lay](numCols) = 1.0;
+    Map<const MatrixXf> weights(m_floatParameters.data() + m_layerOffsets[lay],
+                                m_layerSizes[lay] + 1, m_layerSizes[lay + 1]);
+    Index numInputs = weights.rows() - 1;
+
+    RowMatrixXf &buffer = workspace.floatLayers[lay];
+    if (buffer.rows() < numRows || buffer.cols() != weights.cols()) {
+      buffer.resize(std::max(numRows, buffer.rows()), weights.cols());
+    }
+
+    RowMatrixXf::RowsBlockXpr next = buffer.topRows(numRows);
+    const RowMatrixXf &previous =
+        (lay == 0) ? input : workspace.floatLayers[lay - 1];
+    next.noalias() = previous.topRows(numRows) * weights.topRows(numInputs);
+    next.rowwise() += weights.row(numInputs);
+    applyNonlinearityRows(next.data(), numRows, next.cols(),
+                          Activations::sigmoid);
+  }
 
-    // Cur = f(layers * weights + bias)...where f(x) is nonlinearity funtion
-    layers.push_back(
-        applyNonlinearity(layers[lay] * m_weights[lay], Activations::sigmoid));
+  MatrixXd &output = workspace.layers[numLayers - 1];
+  const RowMatrixXf &result = workspace.floatLayers[numLayers - 1];
+  if (output.rows() < numRows || output.cols() != result.cols()) {
+    output.resize(std::max(numRows, output.rows()), result.cols());
   }
-  return layers[numLayers];
+  output.topRows(numRows) = result.topRows(numRows).cast<double>();
+  const MatrixXd &constOutput = output;
+  return constOutput.topRows(numRows);
+}
+
+// Scratch space shared by every network used on the calling thread
+NeuralNet::Workspace &NeuralNet::threadWorkspace() {
+  thread_local Workspace workspace;
+  return workspace;
+}
+
+uint64_t NeuralNet::forwardPasses() {
+  return ThreadCounters::total(ThreadCounters::ForwardRows);
+}
+
+const std::vector<unsigned int> &NeuralNet::getLayerSizes() const {
+  return m_layerSizes;
 }
 
-std::vector<MatrixXd> &NeuralNet::getWeights() { return m_weights; }
+// Switches inference to 'kernel', or back to the dynamic path for NULL
+void NeuralNet::setKernel(BatchKernel kernel) { m_kernel = kernel; }
+
+/* Selects the inference precision. Float copies the current weights, so
+ * call this again after changing them; until then the double path is used.
+ */
+void NeuralNet::setPrecision(Precision precision) {
+  m_precision = precision;
+  m_floatStale = true;
+  if (precision == Precision::Float) {
+    m_floatParameters =
+        Map<const VectorXd>(static_cast<const NeuralNet &>(*this).parameters(),
+                            numParameters())
+            .cast<float>();
+    m_floatStale = false;
+  } else {
+    m_floatParameters.resize(0);
+  }
+}
 
-// Sets the internal weights
-void NeuralNet::setWeights(const std::vector<MatrixXd> &weights) {
-  if (weights.size() == 0 || weights.size() != m_weights.size()) {
-    std::cerr << "Error: setWeights(): Weights have different sizes."
+// The dynamic topology fits any network, see FixedNeuralNet::attach
+bool NeuralNet::attach(NeuralNet &net) {
+  net.setKernel(NULL);
+  return true;
+}
+
+/* Copies the current weights into 'slot' of 'arena' and uses that slot as
+ * storage from now on. Genetic::Breed writes the next generation into the
+ * matching back slot, see nextParameters().
+ */
+void NeuralNet::bind(GenomeArena *arena, size_t slot) {
+  if (arena == NULL || slot >= arena->numGenomes() ||
+      arena->genomeSize() != numParameters()) {
+    std::cerr << "Error: bind(): Network does not fit the genome arena."
+              << std::endl;
+    exit(1);
+  }
+  const double *current = static_cast<const NeuralNet &>(*this).parameters();
+  std::copy(current, current + numParameters(), arena->front(slot));
+  m_arena = arena;
+  m_slot = slot;
+  m_view = NULL;
+  releaseMapping();
+  m_ownedParameters.resize(0);
+}
+
+/* Views are for networks that are only played, such as hall of fame
+ * champions kept on disk, so they run in double precision.
+ */
+void NeuralNet::view(const double *parameters) {
+  releaseMapping();
+  m_view = parameters;
+  m_arena = NULL;
+  m_ownedParameters.resize(0);
+  m_precision = Precision::Double;
+  m_floatParameters.resize(0);
+  m_floatStale = true;
+}
+
+// Written by Breed, then swapped in, so the float copy goes stale too
+double *NeuralNet::nextParameters() {
+  m_floatStale = true;
+  return m_arena != NULL ? m_arena->back(m_slot) : NULL;
+}
+
+size_t NeuralNet::numParameters() const { return m_layerOffsets.back(); }
+
+// The caller may change the weights, so the float copy is no longer trusted
+double *NeuralNet::parameters() {
+  if (m_view != NULL) {
+    std::cerr << "Error: parameters(): Network is a read-only view."
               << std::endl;
     exit(1);
   }
-  for (unsigned int i = 0; i < m_weights.size(); ++i) {
-    m_weights[i] = weights[i];
+  m_floatStale = true;
+  return m_arena != NULL ? m_arena->front(m_slot) : m_ownedParameters.data();
+}
+
+const double *NeuralNet::parameters() const {
+  if (m_view != NULL) {
+    return m_view;
   }
+  return m_arena != NULL ? m_arena->front(m_slot) : m_ownedParameters.data();
+}
+
+unsigned int NeuralNet::numLayers() const { return m_layerOffsets.size() - 1; }
+
+// Weights of layer 'lay' with the bias as the last row
+Map<const MatrixXd> NeuralNet::layer(unsigned int lay) const {
+  return Map<const MatrixXd>(parameters() + m_layerOffsets[lay],
+                             m_layerSizes[lay] + 1, m_layerSizes[lay + 1]);
 }
 
 inline RowVectorXd NeuralNet::applyNonlinearity(const RowVectorXd &input,
@@ -161,6 +599,44 @@ inline RowVectorXd NeuralNet::applyNonlinearity(const RowVectorXd &input,
   }
 }
 
+// Applies 'activation' to each row of 'rows' in place
+inline void NeuralNet::applyNonlinearityRows(Ref<MatrixXd> rows,
+                                             Activations activation) const {
+  switch (activation) {
+    case Activations::sigmoid:
+      rows = rows.unaryExpr(&NeuralNet::sigmoid);
+      break;
+    case Activations::relu:
+      rows = rows.unaryExpr(&NeuralNet::relu);
+      break;
+    case Activations::softmax:
+      for (Index i = 0; i < rows.rows(); ++i) {
+        rows.row(i) = applyNonlinearity(rows.row(i), Activations::softmax);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+inline void NeuralNet::applyNonlinearityRows(float *rows, Index numRows,
+                                             Index rowSize,
+                                             Activations activation) const {
+  switch (activation) {
+    case Activations::sigmoid:
+      SimdActivations::sigmoid(rows, numRows * rowSize);
+      break;
+    case Activations::relu:
+      SimdActivations::relu(rows, numRows * rowSize);
+      break;
+    case Activations::softmax:
+      SimdActivations::softmax(rows, numRows, rowSize);
+      break;
+    default:
+      break;
+  }
+}
+
 inline double NeuralNet::relu(double x) { return std::max(0.0, x); }
 
 inline double NeuralNet::sigmoid(double x) { return 1.0 / (1.0 + exp(-x)); }
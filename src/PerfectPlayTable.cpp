@@ -0,0 +1,90 @@
+#include "PerfectPlayTable.h"
+
+#include <algorithm>
+
+static const int LINES[8][3] = {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {0, 3, 6},
+                                {1, 4, 7}, {2, 5, 8}, {0, 4, 8}, {2, 4, 6}};
+
+static int power(int square) {
+  int result = 1;
+  for (int i = square; i < 8; ++i) {
+    result *= 3;
+  }
+  return result;
+}
+
+static bool hasLine(const int cells[9], int player) {
+  for (int i = 0; i < 8; ++i) {
+    if (cells[LINES[i][0]] == player && cells[LINES[i][1]] == player &&
+        cells[LINES[i][2]] == player) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int PerfectPlayTable::value(int state) { return instance().m_values[state]; }
+
+uint16_t PerfectPlayTable::bestMoves(int state) {
+  return instance().m_bestMoves[state];
+}
+
+int PerfectPlayTable::moveOffset(int square, int player) {
+  return player * power(square);
+}
+
+// Solved on first use; initialisation of the local static is thread-safe
+const PerfectPlayTable &PerfectPlayTable::instance() {
+  static const PerfectPlayTable table;
+  return table;
+}
+
+PerfectPlayTable::PerfectPlayTable() {
+  std::fill(m_values, m_values + NUM_STATES, 0);
+  std::fill(m_bestMoves, m_bestMoves + NUM_STATES, 0);
+  std::fill(m_solved, m_solved + NUM_STATES, false);
+  int cells[9] = {0};
+  solve(0, cells, 0);
+}
+
+// Depth-first search from the empty board, each position solved only once
+int PerfectPlayTable::solve(int state, int cells[9], int pieces) {
+  if (m_solved[state]) {
+    return m_values[state];
+  }
+  m_solved[state] = true;
+
+  // The side that just moved is the only one that can have a new line
+  int previous = (pieces % 2 == 1) ? 1 : 2;
+  if (pieces > 0 && hasLine(cells, previous)) {
+    m_values[state] = (int8_t)((previous == 1 ? 1 : -1) * (10 - pieces));
+    return m_values[state];
+  }
+  if (pieces == 9) {
+    return 0;
+  }
+
+  int player = (pieces % 2 == 0) ? 1 : 2;
+  int sign = (player == 1) ? 1 : -1;
+  int best = -100;
+  uint16_t bestMoves = 0;
+  for (int square = 0; square < 9; ++square) {
+    if (cells[square] != 0) {
+      continue;
+    }
+    cells[square] = player;
+    int child = solve(state + moveOffset(square, player), cells, pieces + 1);
+    cells[square] = 0;
+
+    if (sign * child > best) {
+      best = sign * child;
+      bestMoves = 0;
+    }
+    if (sign * child == best) {
+      bestMoves |= (uint16_t)(1 << square);
+    }
+  }
+  m_values[state] = (int8_t)(sign * best);
+  m_bestMoves[state] = bestMoves;
+  return m_values[state];
+}
@@ -0,0 +1,270 @@
+#include "Philox.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+static const int PHILOX_ROUNDS = 10;
+
+static const uint64_t ONE_BITS = 0x3FF0000000000000ull;  // 1.0
+static const uint64_t MANTISSA_MASK = 0x000FFFFFFFFFFFFFull;
+// 2^52 + 1023: the biased exponent written into the mantissa of 2^52
+static const uint64_t EXPONENT_MAGIC_BITS = 0x4330000000000000ull;
+static const double EXPONENT_MAGIC = 4503599627371519.0;
+static const double TWO_PI = 6.283185307179586;
+static const double LN2 = 0.6931471805599453;
+static const double SQRT2 = 1.4142135623730951;
+
+// Taylor coefficients of sin(x) / x and cos(x) in x^2, for |x| <= pi / 4
+static const double SIN_C[6] = {-1.0 / 39916800.0, 1.0 / 362880.0,
+                                -1.0 / 5040.0,     1.0 / 120.0,
+                                -1.0 / 6.0,        1.0};
+static const double COS_C[7] = {1.0 / 479001600.0, -1.0 / 3628800.0,
+                                1.0 / 40320.0,     -1.0 / 720.0,
+                                1.0 / 24.0,        -0.5,
+                                1.0};
+// 2 atanh(t) / t in t^2
+static const double LOG_C[7] = {2.0 / 13.0, 2.0 / 11.0, 2.0 / 9.0, 2.0 / 7.0,
+                                2.0 / 5.0,  2.0 / 3.0,  2.0};
+
+static inline double fromBits(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static inline uint64_t toBits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+Philox::Philox(uint64_t seed) {
+  m_key[0] = (uint32_t)seed;
+  m_key[1] = (uint32_t)(seed >> 32);
+}
+
+void Philox::block(uint64_t stream, uint64_t index, uint32_t out[4]) const {
+  uint32_t c0 = (uint32_t)index;
+  uint32_t c1 = (uint32_t)(index >> 32);
+  uint32_t c2 = (uint32_t)stream;
+  uint32_t c3 = (uint32_t)(stream >> 32);
+  uint32_t k0 = m_key[0];
+  uint32_t k1 = m_key[1];
+  for (int round = 0; round < PHILOX_ROUNDS; ++round) {
+    uint64_t product0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t product1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t next0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+    uint32_t next2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)product1;
+    c3 = (uint32_t)product0;
+    c0 = next0;
+    c2 = next2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/* One block gives two uniforms of 52 bits each, and Box-Muller turns them
+ * into two normals:
+ *   r = sqrt(-2 ln u1),  z0 = r cos(2 pi u2),  z1 = r sin(2 pi u2)
+ * u1 is taken from (0, 1] so the logarithm is finite. ln is computed as
+ * e ln 2 + 2 atanh((m - 1) / (m + 1)) with m in [sqrt(1/2), sqrt(2)), and
+ * 2 pi u2 is reduced to the nearest quarter turn so the sine and cosine
+ * series only see |x| <= pi / 4. Both are accurate to about 1e-11. The
+ * AVX2 path evaluates the same formulas four pairs at a time.
+ */
+static inline void normalPair(const uint32_t words[4], double stddev,
+                              double *z0, double *z1) {
+  uint64_t bits1 = ((uint64_t)words[0] << 32) | words[1];
+  uint64_t bits2 = ((uint64_t)words[2] << 32) | words[3];
+  double u1 = 2.0 - fromBits((bits1 >> 12) | ONE_BITS);
+  double u2 = fromBits((bits2 >> 12) | ONE_BITS) - 1.0;
+
+  uint64_t logBits = toBits(u1);
+  double exponent =
+      fromBits((logBits >> 52) | EXPONENT_MAGIC_BITS) - EXPONENT_MAGIC;
+  double m = fromBits((logBits & MANTISSA_MASK) | ONE_BITS);
+  if (m > SQRT2) {
+    m *= 0.5;
+    exponent += 1.0;
+  }
+  double t = (m - 1.0) / (m + 1.0);
+  double t2 = t * t;
+  double p = LOG_C[0];
+  for (int i = 1; i < 7; ++i) {
+    p = p * t2 + LOG_C[i];
+  }
+  double radius = stddev * std::sqrt(-2.0 * (exponent * LN2 + t * p));
+
+  double quarter = std::floor(4.0 * u2 + 0.5);
+  double x = TWO_PI * (u2 - 0.25 * quarter);
+  double x2 = x * x;
+  double s = SIN_C[0];
+  for (int i = 1; i < 6; ++i) {
+    s = s * x2 + SIN_C[i];
+  }
+  s *= x;
+  double c = COS_C[0];
+  for (int i = 1; i < 7; ++i) {
+    c = c * x2 + COS_C[i];
+  }
+
+  // Rotate back by the removed quarter turns
+  int k = (int)quarter & 3;
+  double sine = (k & 1) ? c : s;
+  double cosine = (k & 1) ? s : c;
+  *z0 = radius * (((k + 1) & 2) ? -cosine : cosine);
+  *z1 = radius * ((k & 2) ? -sine : sine);
+}
+
+#if defined(__AVX2__)
+static inline __m256i philox4(const uint32_t key[2], uint64_t stream,
+                              uint64_t index, __m256i *bits2) {
+  const __m256i low = _mm256_set1_epi64x(0xFFFFFFFF);
+  const __m256i m0 = _mm256_set1_epi64x(PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi64x(PHILOX_M1);
+  // One counter per 64-bit lane, each 32-bit word zero-extended
+  __m256i counter = _mm256_add_epi64(_mm256_set1_epi64x(index),
+                                     _mm256_set_epi64x(3, 2, 1, 0));
+  __m256i c0 = _mm256_and_si256(counter, low);
+  __m256i c1 = _mm256_srli_epi64(counter, 32);
+  __m256i c2 = _mm256_set1_epi64x(stream & 0xFFFFFFFF);
+  __m256i c3 = _mm256_set1_epi64x(stream >> 32);
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+  for (int round = 0; round < PHILOX_ROUNDS; ++round) {
+    __m256i product0 = _mm256_mul_epu32(c0, m0);
+    __m256i product1 = _mm256_mul_epu32(c2, m1);
+    __m256i next0 = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_srli_epi64(product1, 32), c1),
+        _mm256_set1_epi64x(k0));
+    __m256i next2 = _mm256_xor_si256(
+        _mm256_xor_si256(_mm256_srli_epi64(product0, 32), c3),
+        _mm256_set1_epi64x(k1));
+    c1 = _mm256_and_si256(product1, low);
+    c3 = _mm256_and_si256(product0, low);
+    c0 = next0;
+    c2 = next2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  *bits2 = _mm256_or_si256(_mm256_slli_epi64(c2, 32), c3);
+  return _mm256_or_si256(_mm256_slli_epi64(c0, 32), c1);
+}
+
+static inline __m256d horner(__m256d x, const double *coefficients,
+                             int count) {
+  __m256d p = _mm256_set1_pd(coefficients[0]);
+  for (int i = 1; i < count; ++i) {
+    p = _mm256_add_pd(_mm256_mul_pd(p, x), _mm256_set1_pd(coefficients[i]));
+  }
+  return p;
+}
+
+// normalPair for the four blocks starting at 'index'
+static inline void normalPairs4(const uint32_t key[2], uint64_t stream,
+                                uint64_t index, double stddev, __m256d *z0,
+                                __m256d *z1) {
+  const __m256i one = _mm256_set1_epi64x(ONE_BITS);
+  const __m256d oneD = _mm256_set1_pd(1.0);
+  __m256i bits2;
+  __m256i bits1 = philox4(key, stream, index, &bits2);
+  __m256d u1 = _mm256_sub_pd(
+      _mm256_set1_pd(2.0),
+      _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits1, 12), one)));
+  __m256d u2 = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits2, 12), one)),
+      oneD);
+
+  __m256i logBits = _mm256_castpd_si256(u1);
+  __m256d exponent = _mm256_sub_pd(
+      _mm256_castsi256_pd(
+          _mm256_or_si256(_mm256_srli_epi64(logBits, 52),
+                          _mm256_set1_epi64x(EXPONENT_MAGIC_BITS))),
+      _mm256_set1_pd(EXPONENT_MAGIC));
+  __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+      _mm256_and_si256(logBits, _mm256_set1_epi64x(MANTISSA_MASK)), one));
+  __m256d high = _mm256_cmp_pd(m, _mm256_set1_pd(SQRT2), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), high);
+  exponent = _mm256_add_pd(exponent, _mm256_and_pd(high, oneD));
+  __m256d t =
+      _mm256_div_pd(_mm256_sub_pd(m, oneD), _mm256_add_pd(m, oneD));
+  __m256d log = _mm256_add_pd(
+      _mm256_mul_pd(exponent, _mm256_set1_pd(LN2)),
+      _mm256_mul_pd(t, horner(_mm256_mul_pd(t, t), LOG_C, 7)));
+  __m256d radius = _mm256_mul_pd(
+      _mm256_set1_pd(stddev),
+      _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0), log)));
+
+  __m256d quarter = _mm256_floor_pd(_mm256_add_pd(
+      _mm256_mul_pd(u2, _mm256_set1_pd(4.0)), _mm256_set1_pd(0.5)));
+  __m256d x = _mm256_mul_pd(
+      _mm256_set1_pd(TWO_PI),
+      _mm256_sub_pd(u2, _mm256_mul_pd(quarter, _mm256_set1_pd(0.25))));
+  __m256d x2 = _mm256_mul_pd(x, x);
+  __m256d s = _mm256_mul_pd(horner(x2, SIN_C, 6), x);
+  __m256d c = horner(x2, COS_C, 7);
+
+  // quarter is a small integer, so its low bits are in the mantissa of
+  // quarter + 2^52; bit 0 swaps sine and cosine, sign bits come from k & 2
+  __m256i k = _mm256_castpd_si256(
+      _mm256_add_pd(quarter, _mm256_set1_pd(4503599627370496.0)));
+  __m256i bit0 = _mm256_and_si256(k, _mm256_set1_epi64x(1));
+  __m256d swap =
+      _mm256_castsi256_pd(_mm256_cmpeq_epi64(bit0, _mm256_set1_epi64x(1)));
+  __m256d sine = _mm256_blendv_pd(s, c, swap);
+  __m256d cosine = _mm256_blendv_pd(c, s, swap);
+  __m256d sineSign = _mm256_castsi256_pd(_mm256_slli_epi64(
+      _mm256_and_si256(k, _mm256_set1_epi64x(2)), 62));
+  __m256d cosineSign = _mm256_castsi256_pd(_mm256_slli_epi64(
+      _mm256_and_si256(_mm256_add_epi64(k, _mm256_set1_epi64x(1)),
+                       _mm256_set1_epi64x(2)),
+      62));
+  *z0 = _mm256_mul_pd(radius, _mm256_xor_pd(cosine, cosineSign));
+  *z1 = _mm256_mul_pd(radius, _mm256_xor_pd(sine, sineSign));
+}
+#endif
+
+void Philox::addNormal(double *values, size_t count, double stddev,
+                       uint64_t stream, uint64_t firstBlock) const {
+  size_t numPairs = (count + 1) / 2;
+  size_t pair = 0;
+#if defined(__AVX2__)
+  for (; 2 * (pair + 4) <= count; pair += 4) {
+    __m256d z0, z1;
+    normalPairs4(m_key, stream, firstBlock + pair, stddev, &z0, &z1);
+    // Interleave to z0[0] z1[0] z0[1] z1[1] | z0[2] z1[2] z0[3] z1[3]
+    __m256d even = _mm256_unpacklo_pd(z0, z1);
+    __m256d odd = _mm256_unpackhi_pd(z0, z1);
+    double *out = values + 2 * pair;
+    _mm256_storeu_pd(out, _mm256_add_pd(_mm256_loadu_pd(out),
+                                        _mm256_permute2f128_pd(even, odd,
+                                                               0x20)));
+    _mm256_storeu_pd(out + 4, _mm256_add_pd(_mm256_loadu_pd(out + 4),
+                                            _mm256_permute2f128_pd(even, odd,
+                                                                   0x31)));
+  }
+#endif
+  for (; pair < numPairs; ++pair) {
+    uint32_t words[4];
+    double z0, z1;
+    block(stream, firstBlock + pair, words);
+    normalPair(words, stddev, &z0, &z1);
+    values[2 * pair] += z0;
+    if (2 * pair + 1 < count) {
+      values[2 * pair + 1] += z1;
+    }
+  }
+}
@@ -1,6 +1,12 @@
 
 #include "Player.h"
 
+#include <algorithm>
+#include "AlphaBeta.h"
+#include "PerfectPlayTable.h"
+#include "TicTacToe.h"
+#include "UltimateTTT.h"
+
 //---------------Player---------------
 Player::Player() : index(Player::count++), fitness(0) {}
 
@@ -30,13 +36,33 @@ void Player::Swap(Player *left, Player *right) {
   right->fitness = fitnessTemp;
 }
 
+void Player::scoreMoves(const TicTacToe &game, uint16_t,
+                        double *scores) const {
+  RowVectorXd move =
+      getMove(game.toPlayerPerspective(game.sideToMove()));
+  for (Index i = 0; i < move.size() && i < TicTacToe::NUM_ACTIONS; ++i) {
+    scores[i] = move(i);
+  }
+}
+
+void Player::scoreMoves(const UltimateTTT &game, const uint64_t *,
+                        double *scores) const {
+  RowVectorXd move = getMove(game.toPlayerPerspective(game.sideToMove()));
+  for (Index i = 0; i < move.size() && i < UltimateTTT::NUM_ACTIONS; ++i) {
+    scores[i] = move(i);
+  }
+}
+
+const NeuralPlayer *Player::asNeural() const { return NULL; }
+
 unsigned int Player::count = 0;
 
 //----------NeuralPlayer--------------
 NeuralPlayer::NeuralPlayer() : Player(), neural() {}
 
-NeuralPlayer::NeuralPlayer(const std::vector<unsigned int> &layerSizes)
-    : Player(), neural(layerSizes) {}
+NeuralPlayer::NeuralPlayer(const std::vector<unsigned int> &layerSizes,
+                           RandomStream &random)
+    : Player(), neural(layerSizes, random) {}
 
 NeuralPlayer::NeuralPlayer(const NeuralPlayer &other)
     : Player(other), neural(other.neural) {}
@@ -52,6 +78,39 @@ RowVectorXd NeuralPlayer::getMove(const RowVectorXd &input) const {
   return neural.forward(input);
 }
 
+// Scores the board after every legal move in one batch
+void NeuralPlayer::scoreMoves(const TicTacToe &game, uint16_t,
+                              double *scores) const {
+  int squares[9];
+  Matrix<double, 9, 9> candidates;
+  int numLegal = game.afterMoveBoards(
+      game.toPlayerPerspective(game.sideToMove()), candidates, 0, squares);
+  NeuralNet::ConstBatch values = getMoves(candidates.topRows(numLegal));
+  for (int k = 0; k < numLegal; ++k) {
+    scores[squares[k]] = values(k, 0);
+  }
+}
+
+// The candidate boards are kept per thread, there can be 81 of them
+void NeuralPlayer::scoreMoves(const UltimateTTT &game, const uint64_t *,
+                              double *scores) const {
+  thread_local MatrixXd candidates(UltimateTTT::NUM_ACTIONS,
+                                   UltimateTTT::NUM_PERCEPTS);
+  int actions[UltimateTTT::NUM_ACTIONS];
+  int numLegal = game.afterMoveBoards(candidates, 0, actions);
+  NeuralNet::ConstBatch values = getMoves(candidates.topRows(numLegal));
+  for (int k = 0; k < numLegal; ++k) {
+    scores[actions[k]] = values(k, 0);
+  }
+}
+
+const NeuralPlayer *NeuralPlayer::asNeural() const { return this; }
+
+NeuralNet::ConstBatch NeuralPlayer::getMoves(
+    const Ref<const MatrixXd> &inputs) const {
+  return neural.forwardBatch(inputs, NeuralNet::threadWorkspace());
+}
+
 //----------ManualPlayer--------------
 ManualPlayer::ManualPlayer(std::istream &is, std::ostream &os,
                            const int numActions)
@@ -69,7 +128,7 @@ void ManualPlayer::operator=(const ManualPlayer &right) {
   Player::operator=(right);
 }
 
-RowVectorXd ManualPlayer::getMove(const RowVectorXd &input) const {
+RowVectorXd ManualPlayer::getMove(const RowVectorXd &) const {
   int move;
   do {
     m_os << "Your move, as a number from 0 to " << m_numActions - 1 << ": ";
@@ -81,42 +140,131 @@ RowVectorXd ManualPlayer::getMove(const RowVectorXd &input) const {
   return temp;
 }
 
+void ManualPlayer::scoreMoves(const TicTacToe &game, uint16_t,
+                              double *scores) const {
+  double index =
+      (getMove(game.toPlayerPerspective(game.sideToMove())))(0);
+  scores[(int)index] = 1.0;
+}
+
+void ManualPlayer::scoreMoves(const UltimateTTT &game, const uint64_t *,
+                              double *scores) const {
+  double index = (getMove(game.toPlayerPerspective(game.sideToMove())))(0);
+  scores[(int)index] = 1.0;
+}
+
 //----------RandomPlayer--------------
-RandomPlayer::RandomPlayer(const int _size) : Player(), size(_size) {}
+// Without a stream, each player draws from its own one of the run seed
+RandomPlayer::RandomPlayer(const int _size)
+    : Player(),
+      size(_size),
+      m_random(RandomStream::get(RandomPurpose::Player, 0, index)) {}
+
+RandomPlayer::RandomPlayer(const int _size, const RandomStream &random)
+    : Player(), size(_size), m_random(random) {}
 
 RandomPlayer::RandomPlayer(const RandomPlayer &other)
-    : Player(other), size(other.size) {}
+    : Player(other), size(other.size), m_random(other.m_random) {}
 
 RandomPlayer::~RandomPlayer() {}
 
 void RandomPlayer::operator=(const RandomPlayer &right) {
   Player::operator=(right);
+  m_random = right.m_random;
 }
 
-RowVectorXd RandomPlayer::getMove(const RowVectorXd &input) const {
+void RandomPlayer::reseed(const RandomStream &random) { m_random = random; }
+
+RowVectorXd RandomPlayer::getMove(const RowVectorXd &) const {
   RowVectorXd ret(size);
   const int resolution = 10000;
   for (int i = 0; i < size; ++i) {
-    ret(i) = (double)(rand() % (resolution + 1)) / resolution;
+    ret(i) = (double)m_random.below(resolution + 1) / resolution;
   }
   return ret;
 }
 
+// Same draws as getMove() without building a vector
+void RandomPlayer::scoreMoves(const TicTacToe &, uint16_t,
+                              double *scores) const {
+  const int resolution = 10000;
+  for (int i = 0; i < size && i < TicTacToe::NUM_ACTIONS; ++i) {
+    scores[i] = (double)m_random.below(resolution + 1) / resolution;
+  }
+}
+
+void RandomPlayer::scoreMoves(const UltimateTTT &, const uint64_t *,
+                              double *scores) const {
+  const int resolution = 10000;
+  for (int i = 0; i < size && i < UltimateTTT::NUM_ACTIONS; ++i) {
+    scores[i] = (double)m_random.below(resolution + 1) / resolution;
+  }
+}
+
+//----------SearchPlayer--------------
+SearchPlayer::SearchPlayer(const int depth) : Player(), m_depth(depth) {}
+
+SearchPlayer::SearchPlayer(const SearchPlayer &other)
+    : Player(other), m_depth(other.m_depth) {}
+
+SearchPlayer::~SearchPlayer() {}
+
+void SearchPlayer::operator=(const SearchPlayer &right) {
+  Player::operator=(right);
+  m_depth = right.m_depth;
+}
+
+int SearchPlayer::getDepth() const { return m_depth; }
+
+RowVectorXd SearchPlayer::getMove(const RowVectorXd &input) const {
+  return RowVectorXd::Zero(input.size());
+}
+
+// Each move is scored by searching the board it leads to. The engine and
+// its table are per thread and kept between moves and games.
+void SearchPlayer::scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                              double *scores) const {
+  thread_local AlphaBeta<TicTacToePosition> engine(12);
+  TicTacToePosition position = game.toPosition();
+  for (int i = 0; i < 9; ++i) {
+    if ((legalMoves >> i) & 1) {
+      scores[i] = engine.scoreMove(position, i, m_depth);
+    }
+  }
+}
+
 //----------PerfectPlayer--------------
 
-PerfectPlayer::PerfectPlayer() : Player() {}
+PerfectPlayer::PerfectPlayer()
+    : Player(), m_random(RandomStream::get(RandomPurpose::Player, 0, index)) {}
 
-PerfectPlayer::PerfectPlayer(const PerfectPlayer &other) : Player(other) {}
+PerfectPlayer::PerfectPlayer(const PerfectPlayer &other)
+    : Player(other), m_random(other.m_random) {}
 
 PerfectPlayer::~PerfectPlayer() {}
 
 void PerfectPlayer::operator=(const PerfectPlayer &right) {
   Player::operator=(right);
+  m_random = right.m_random;
 }
 
-RowVectorXd PerfectPlayer::getMove(const RowVectorXd &input) const {
+RowVectorXd PerfectPlayer::getMove(const RowVectorXd &) const {
   RowVectorXd ret(1);
   const int resolution = 10000;
-  ret << (double)(rand() % (resolution + 1)) / resolution;
+  ret << (double)m_random.below(resolution + 1) / resolution;
   return ret;
 }
+
+// Each move is scored by the solved value of the board it leads to
+void PerfectPlayer::scoreMoves(const TicTacToe &game, uint16_t legalMoves,
+                               double *scores) const {
+  int side = (int)game.sideToMove();
+  double sign = (game.sideToMove() == States::playerO) ? -1.0 : 1.0;
+  int index = game.tableIndex();
+  for (int i = 0; i < 9; ++i) {
+    if ((legalMoves >> i) & 1) {
+      scores[i] = sign * PerfectPlayTable::value(
+                             index + PerfectPlayTable::moveOffset(i, side));
+    }
+  }
+}
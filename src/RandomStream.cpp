@@ -0,0 +1,67 @@
+#include "RandomStream.h"
+
+#include <chrono>
+
+uint64_t RandomStream::runSeed = 0;
+
+// SplitMix64 finaliser, spreads nearby seeds over the whole key space
+static uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+RandomStream::RandomStream(uint64_t key, uint64_t stream)
+    : m_generator(key), m_stream(stream), m_block(0), m_used(4) {}
+
+RandomStream RandomStream::get(RandomPurpose purpose, uint32_t generation,
+                               uint32_t individual) {
+  uint64_t key = mix(runSeed + 0x9E3779B97F4A7C15ull * (uint64_t)purpose);
+  return RandomStream(key, ((uint64_t)generation << 32) | individual);
+}
+
+// Sequence s starts 2^40 blocks into the stream, far beyond what one draws
+RandomStream RandomStream::get(RandomPurpose purpose, uint32_t generation,
+                               uint32_t individual, uint32_t sequence) {
+  RandomStream random = get(purpose, generation, individual);
+  random.m_block = (uint64_t)sequence << 40;
+  return random;
+}
+
+void RandomStream::setRunSeed(uint64_t seed) { runSeed = seed; }
+
+uint64_t RandomStream::getRunSeed() { return runSeed; }
+
+uint64_t RandomStream::timeSeed() {
+  using namespace std::chrono;
+  return mix(
+      (uint64_t)high_resolution_clock::now().time_since_epoch().count());
+}
+
+uint32_t RandomStream::next() {
+  if (m_used == 4) {
+    m_generator.block(m_stream, m_block++, m_words);
+    m_used = 0;
+  }
+  return m_words[m_used++];
+}
+
+double RandomStream::uniform() {
+  // Drawn in sequence; the order of operands in one expression is unspecified
+  uint64_t high = next();
+  uint64_t low = next();
+  uint64_t bits = (high << 32) | low;
+  return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Lemire's multiply-shift; the bias is below 2^-32 * bound
+unsigned int RandomStream::below(unsigned int bound) {
+  return (unsigned int)(((uint64_t)next() * bound) >> 32);
+}
+
+// Normals use whole blocks, continuing after the ones already drawn
+void RandomStream::addNormal(double *values, size_t count, double stddev) {
+  m_generator.addNormal(values, count, stddev, m_stream, m_block);
+  m_block += (count + 1) / 2;
+  m_used = 4;
+}
@@ -0,0 +1,101 @@
+#include "Selection.h"
+
+#include <algorithm>
+#include <cmath>
+
+Selection::Selection(SelectionMethod method, unsigned int tournamentSize)
+    : m_method(method),
+      m_tournamentSize(std::max(1u, tournamentSize)),
+      m_population(NULL) {}
+
+void Selection::setMethod(SelectionMethod method,
+                          unsigned int tournamentSize) {
+  m_method = method;
+  m_tournamentSize = std::max(1u, tournamentSize);
+}
+
+SelectionMethod Selection::getMethod() const { return m_method; }
+
+unsigned int Selection::getTournamentSize() const { return m_tournamentSize; }
+
+size_t Selection::reserved() const { return m_cumulative.capacity(); }
+
+void Selection::prepare(const std::vector<Player *> &population) {
+  m_population = &population;
+  m_cumulative.clear();
+  if (m_method != SelectionMethod::Proportional) {
+    return;
+  }
+
+  // Negative fitness would make the totals non-monotonic; such players
+  // simply never get picked
+  m_cumulative.reserve(population.size());
+  double total = 0;
+  for (unsigned int i = 0; i < population.size(); ++i) {
+    total += std::max(0.0, population[i]->fitness);
+    m_cumulative.push_back(total);
+  }
+}
+
+unsigned int Selection::pick(RandomStream &random) const {
+  if (m_population == NULL || m_population->empty()) {
+    std::cerr << "Error: pick(): Selection was not prepared." << std::endl;
+    exit(1);
+  }
+  switch (m_method) {
+    case SelectionMethod::Tournament:
+      return pickTournament(random);
+    case SelectionMethod::Rank:
+      return pickRank(random);
+    case SelectionMethod::Proportional:
+    default:
+      return pickProportional(random);
+  }
+}
+
+// Binary search of a uniform point in [0, total) among the running totals.
+// When nobody scored, every player is equally likely.
+unsigned int Selection::pickProportional(RandomStream &random) const {
+  unsigned int size = m_cumulative.size();
+  double total = m_cumulative.back();
+  if (!(total > 0)) {
+    return random.below(size);
+  }
+  double threshold = random.uniform() * total;
+  unsigned int index =
+      std::upper_bound(m_cumulative.begin(), m_cumulative.end(), threshold) -
+      m_cumulative.begin();
+  return std::min(index, size - 1);
+}
+
+// Ties go to the later, i.e. sorted higher, player
+unsigned int Selection::pickTournament(RandomStream &random) const {
+  const std::vector<Player *> &population = *m_population;
+  unsigned int size = population.size();
+  unsigned int best = random.below(size);
+  for (unsigned int i = 1; i < m_tournamentSize; ++i) {
+    unsigned int challenger = random.below(size);
+    if (population[challenger]->fitness > population[best]->fitness ||
+        (population[challenger]->fitness == population[best]->fitness &&
+         challenger > best)) {
+      best = challenger;
+    }
+  }
+  return best;
+}
+
+/* Player i (0 = least fit) has weight i + 1, so the running total up to and
+ * including i is (i + 1)(i + 2) / 2. The player holding a uniform point t
+ * in [0, N(N + 1) / 2) is the smallest i with (i + 1)(i + 2) / 2 > t, found
+ * by solving the quadratic and correcting the rounding.
+ */
+unsigned int Selection::pickRank(RandomStream &random) const {
+  double size = (double)m_population->size();
+  double threshold = random.uniform() * size * (size + 1) / 2;
+  double root = std::floor((std::sqrt(8 * threshold + 1) - 1) / 2);
+  unsigned int index = (unsigned int)std::max(0.0, root - 1);
+  while ((index + 1.0) * (index + 2.0) / 2 <= threshold) {
+    ++index;
+  }
+  return std::min(index, (unsigned int)m_population->size() - 1);
+}
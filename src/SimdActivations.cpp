@@ -0,0 +1,166 @@
+#include "SimdActivations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// exp(x) = 2^n * 2^f with n = round(x * log2(e)) and f in [-0.5, 0.5].
+// 2^f comes from its Taylor series, 2^n is written into the exponent bits.
+static const float EXP_MIN = -87.0f;
+static const float EXP_MAX = 88.0f;
+static const float LOG2E = 1.44269504f;
+static const float EXP_C1 = 0.693147181f;
+static const float EXP_C2 = 0.240226507f;
+static const float EXP_C3 = 0.0555041087f;
+static const float EXP_C4 = 0.00961812911f;
+static const float EXP_C5 = 0.00133335581f;
+static const float EXP_C6 = 0.000154035304f;
+
+float SimdActivations::fastExp(float x) {
+  x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+  float t = x * LOG2E;
+  float n = std::nearbyint(t);
+  float f = t - n;
+  float p = EXP_C6;
+  p = p * f + EXP_C5;
+  p = p * f + EXP_C4;
+  p = p * f + EXP_C3;
+  p = p * f + EXP_C2;
+  p = p * f + EXP_C1;
+  p = p * f + 1.0f;
+
+  int32_t bits = ((int32_t)n + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+#if defined(__AVX2__)
+static inline __m256 fastExp8(__m256 x) {
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)),
+                    _mm256_set1_ps(EXP_MAX));
+  __m256 t = _mm256_mul_ps(x, _mm256_set1_ps(LOG2E));
+  __m256 n = _mm256_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 f = _mm256_sub_ps(t, n);
+  __m256 p = _mm256_set1_ps(EXP_C6);
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C5));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C4));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C3));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C2));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_C1));
+  p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+  __m256i bits = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+static inline float horizontalMax8(__m256 v) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+static inline float horizontalSum8(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+#endif
+
+bool SimdActivations::usesAvx2() {
+#if defined(__AVX2__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// 1.0/(1 + e^-x)
+void SimdActivations::sigmoid(float *values, size_t count) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + 8 <= count; i += 8) {
+    __m256 x = _mm256_loadu_ps(values + i);
+    __m256 e = fastExp8(_mm256_sub_ps(zero, x));
+    _mm256_storeu_ps(values + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+  }
+#endif
+  for (; i < count; ++i) {
+    values[i] = 1.0f / (1.0f + fastExp(-values[i]));
+  }
+}
+
+// max(0, x)
+void SimdActivations::relu(float *values, size_t count) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + 8 <= count; i += 8) {
+    __m256 x = _mm256_loadu_ps(values + i);
+    _mm256_storeu_ps(values + i, _mm256_max_ps(x, zero));
+  }
+#endif
+  for (; i < count; ++i) {
+    values[i] = std::max(0.0f, values[i]);
+  }
+}
+
+// e^(x - max) / sum(e^(x - max)) over each row
+void SimdActivations::softmax(float *values, size_t numRows, size_t rowSize) {
+  for (size_t row = 0; row < numRows; ++row) {
+    float *x = values + row * rowSize;
+    size_t i = 0;
+
+    float max = x[0];
+#if defined(__AVX2__)
+    if (rowSize >= 8) {
+      __m256 max8 = _mm256_loadu_ps(x);
+      for (i = 8; i + 8 <= rowSize; i += 8) {
+        max8 = _mm256_max_ps(max8, _mm256_loadu_ps(x + i));
+      }
+      max = horizontalMax8(max8);
+    }
+#endif
+    for (; i < rowSize; ++i) {
+      max = std::max(max, x[i]);
+    }
+
+    float sum = 0.0f;
+    i = 0;
+#if defined(__AVX2__)
+    __m256 sum8 = _mm256_setzero_ps();
+    const __m256 max8 = _mm256_set1_ps(max);
+    for (; i + 8 <= rowSize; i += 8) {
+      __m256 e = fastExp8(_mm256_sub_ps(_mm256_loadu_ps(x + i), max8));
+      _mm256_storeu_ps(x + i, e);
+      sum8 = _mm256_add_ps(sum8, e);
+    }
+    sum = horizontalSum8(sum8);
+#endif
+    for (; i < rowSize; ++i) {
+      x[i] = fastExp(x[i] - max);
+      sum += x[i];
+    }
+
+    float scale = 1.0f / sum;
+    i = 0;
+#if defined(__AVX2__)
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    for (; i + 8 <= rowSize; i += 8) {
+      _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), scale8));
+    }
+#endif
+    for (; i < rowSize; ++i) {
+      x[i] *= scale;
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#include "ThreadCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/* One thread's slots. Only the owning thread writes them, with a relaxed
+ * load and store rather than an atomic add, and total() may read them at
+ * any time.
+ */
+struct CounterBlock {
+  std::atomic<uint64_t> slots[ThreadCounters::NumSlots];
+
+  CounterBlock();
+  ~CounterBlock();
+};
+
+struct CounterRegistry {
+  std::mutex mutex;
+  std::vector<CounterBlock *> blocks;
+  uint64_t retired[ThreadCounters::NumSlots];
+};
+
+static CounterRegistry &counterRegistry() {
+  static CounterRegistry registry = {};
+  return registry;
+}
+
+static CounterBlock &threadBlock() {
+  thread_local CounterBlock block;
+  return block;
+}
+
+CounterBlock::CounterBlock() {
+  for (int s = 0; s < ThreadCounters::NumSlots; ++s) {
+    slots[s].store(0, std::memory_order_relaxed);
+  }
+  CounterRegistry &registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.blocks.push_back(this);
+}
+
+CounterBlock::~CounterBlock() {
+  CounterRegistry &registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (int s = 0; s < ThreadCounters::NumSlots; ++s) {
+    registry.retired[s] += slots[s].load(std::memory_order_relaxed);
+  }
+  registry.blocks.erase(
+      std::find(registry.blocks.begin(), registry.blocks.end(), this));
+}
+
+void ThreadCounters::add(int slot, uint64_t amount) {
+  std::atomic<uint64_t> &count = threadBlock().slots[slot];
+  count.store(count.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+}
+
+uint64_t ThreadCounters::total(int slot) {
+  CounterRegistry &registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  uint64_t sum = registry.retired[slot];
+  for (size_t i = 0; i < registry.blocks.size(); ++i) {
+    sum += registry.blocks[i]->slots[slot].load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void ThreadCounters::reset(int slot) {
+  CounterRegistry &registry = counterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.retired[slot] = 0;
+  for (size_t i = 0; i < registry.blocks.size(); ++i) {
+    registry.blocks[i]->slots[slot].store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,125 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include "Tracer.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+    : m_task(NULL),
+      m_count(0),
+      m_chunkSize(1),
+      m_next(0),
+      m_active(0),
+      m_jobId(0),
+      m_stop(false) {
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+  // The constructing thread is expected to be the one calling parallelFor
+  Tracer::nameThread("worker", 0);
+  m_threads.reserve(numThreads - 1);
+  for (unsigned int i = 1; i < numThreads; ++i) {
+    m_threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (size_t i = 0; i < m_threads.size(); ++i) {
+    m_threads[i].join();
+  }
+}
+
+unsigned int ThreadPool::size() const {
+  return (unsigned int)m_threads.size() + 1;
+}
+
+unsigned int ThreadPool::hardwareThreads() {
+  unsigned int numThreads = std::thread::hardware_concurrency();
+  return numThreads < 1 ? 1 : numThreads;
+}
+
+void ThreadPool::parallelFor(size_t count, const Task &task) {
+  if (count == 0) {
+    return;
+  }
+  if (m_threads.empty() || count == 1) {
+    TraceScope trace("task", 0);
+    task(0, count, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    // Several chunks per worker so uneven tasks still balance out
+    m_chunkSize = std::max<size_t>(1, count / (4 * size()));
+    m_next = 0;
+    m_active = (unsigned int)m_threads.size();
+    m_error = NULL;
+    ++m_jobId;
+  }
+  m_wake.notify_all();
+
+  runChunks(0);
+
+  std::exception_ptr error;
+  {
+    // Time spent here is imbalance between the workers
+    TraceScope trace("wait for workers");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_active == 0; });
+    m_task = NULL;
+    error = m_error;
+    m_error = NULL;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::workerLoop(unsigned int worker) {
+  Tracer::nameThread("worker", (int)worker);
+  unsigned long lastJob = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || m_jobId != lastJob; });
+      if (m_stop) {
+        return;
+      }
+      lastJob = m_jobId;
+    }
+
+    runChunks(worker);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_active == 0) {
+      m_done.notify_one();
+    }
+  }
+}
+
+// Claims chunks of the current job until none are left
+void ThreadPool::runChunks(unsigned int worker) {
+  while (true) {
+    size_t begin = m_next.fetch_add(m_chunkSize);
+    if (begin >= m_count) {
+      return;
+    }
+    size_t end = std::min(begin + m_chunkSize, m_count);
+    TraceScope trace("task", (int64_t)begin);
+    try {
+      (*m_task)(begin, end, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) {
+        m_error = std::current_exception();
+      }
+    }
+  }
+}
@@ -0,0 +1,200 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent {
+  const char *name;
+  int64_t arg;
+  int64_t begin;     // nanoseconds since Tracer::start
+  int64_t duration;  // nanoseconds
+};
+
+/* One thread's spans. Only the owning thread writes them. A thread that
+ * exits leaves its buffer, spans and all, to the next new thread, so a dump
+ * still sees them and memory is bounded by the most threads alive at once.
+ * Short-lived threads such as the checkpoint writers thus share a track.
+ */
+struct ThreadTrace {
+  std::vector<TraceEvent> events;
+  size_t next;     // where the next span goes
+  uint64_t total;  // spans recorded since start(), including overwritten
+  int id;
+  unsigned long generation;  // start() this buffer was sized for
+  const char *name;
+  int number;
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<ThreadTrace *> threads;
+  // Buffers of exited threads
+  std::vector<ThreadTrace *> idle;
+  std::atomic<bool> enabled;
+  std::atomic<unsigned long> generation;
+  size_t eventsPerThread;
+  std::chrono::steady_clock::time_point origin;
+
+  TraceRegistry() : enabled(false), generation(0), eventsPerThread(1) {}
+  ~TraceRegistry() {
+    for (size_t i = 0; i < threads.size(); ++i) {
+      delete threads[i];
+    }
+  }
+};
+
+static TraceRegistry &traceRegistry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+// Names given before the thread's first span, see nameThread
+thread_local const char *threadName = NULL;
+thread_local int threadNumber = -1;
+
+// Hands the thread's buffer back when it exits
+struct TraceHandle {
+  ThreadTrace *trace;
+  TraceHandle() : trace(NULL) {}
+  ~TraceHandle() {
+    if (trace != NULL) {
+      TraceRegistry &registry = traceRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.idle.push_back(trace);
+    }
+  }
+};
+
+static ThreadTrace &threadTrace() {
+  thread_local TraceHandle handle;
+  TraceRegistry &registry = traceRegistry();
+  if (handle.trace == NULL) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (!registry.idle.empty()) {
+      handle.trace = registry.idle.back();
+      registry.idle.pop_back();
+    } else {
+      handle.trace = new ThreadTrace();
+      handle.trace->id = (int)registry.threads.size() + 1;
+      handle.trace->generation = 0;
+      registry.threads.push_back(handle.trace);
+    }
+  }
+  ThreadTrace *trace = handle.trace;
+  // Cleared lazily by the thread itself after each start()
+  unsigned long generation =
+      registry.generation.load(std::memory_order_acquire);
+  if (trace->generation != generation) {
+    trace->events.assign(registry.eventsPerThread, TraceEvent());
+    trace->next = 0;
+    trace->total = 0;
+    trace->generation = generation;
+  }
+  trace->name = threadName;
+  trace->number = threadNumber;
+  return *trace;
+}
+
+void Tracer::start(size_t eventsPerThread) {
+  TraceRegistry &registry = traceRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.eventsPerThread = std::max<size_t>(1, eventsPerThread);
+    registry.origin = std::chrono::steady_clock::now();
+    registry.generation.fetch_add(1, std::memory_order_release);
+  }
+  registry.enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::stop() {
+  traceRegistry().enabled.store(false, std::memory_order_release);
+}
+
+bool Tracer::isEnabled() {
+  return traceRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::nameThread(const char *name, int number) {
+  threadName = name;
+  threadNumber = number;
+}
+
+void Tracer::record(const char *name,
+                    std::chrono::steady_clock::time_point begin,
+                    int64_t arg) {
+  using namespace std::chrono;
+  ThreadTrace &trace = threadTrace();
+  const TraceRegistry &registry = traceRegistry();
+  TraceEvent &event = trace.events[trace.next];
+  event.name = name;
+  event.arg = arg;
+  event.begin = duration_cast<nanoseconds>(begin - registry.origin).count();
+  event.duration =
+      duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+  trace.next = (trace.next + 1) % trace.events.size();
+  trace.total++;
+}
+
+/* Spans are written oldest first per thread, with timestamps in
+ * microseconds as the format expects, followed by a name for every
+ * thread that recorded any.
+ */
+bool Tracer::dump(const std::string &path) {
+  TraceRegistry &registry = traceRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (file == NULL) {
+    std::cerr << "Error: Unable to create trace file " << path << std::endl;
+    return false;
+  }
+  unsigned long generation = registry.generation.load();
+  bool first = true;
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (size_t t = 0; t < registry.threads.size(); ++t) {
+    const ThreadTrace &trace = *registry.threads[t];
+    if (trace.generation != generation || trace.total == 0) {
+      continue;
+    }
+    size_t capacity = trace.events.size();
+    size_t count = (size_t)std::min<uint64_t>(trace.total, capacity);
+    size_t oldest = (trace.next + capacity - count) % capacity;
+    for (size_t e = 0; e < count; ++e) {
+      const TraceEvent &event = trace.events[(oldest + e) % capacity];
+      std::fprintf(file,
+                   "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                   "\"ts\":%.3f,\"dur\":%.3f",
+                   first ? "" : ",\n", event.name, trace.id,
+                   event.begin / 1000.0, event.duration / 1000.0);
+      if (event.arg >= 0) {
+        std::fprintf(file, ",\"args\":{\"n\":%lld}", (long long)event.arg);
+      }
+      std::fprintf(file, "}");
+      first = false;
+    }
+
+    char name[64];
+    if (trace.name == NULL) {
+      std::snprintf(name, sizeof(name), "thread %d", trace.id);
+    } else if (trace.number < 0) {
+      std::snprintf(name, sizeof(name), "%s", trace.name);
+    } else {
+      std::snprintf(name, sizeof(name), "%s %d", trace.name, trace.number);
+    }
+    std::fprintf(file,
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 trace.id, name);
+    if (trace.total > capacity) {
+      std::fprintf(file,
+                   ",\n{\"name\":\"overwritten spans\",\"ph\":\"C\","
+                   "\"pid\":1,\"tid\":%d,\"ts\":0,\"args\":{\"n\":%llu}}",
+                   trace.id, (unsigned long long)(trace.total - capacity));
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
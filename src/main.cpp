@@ -1,23 +1,108 @@
 #include <Eigen/Dense>
+#include <cstdlib>
+#include "FixedNeuralNet.h"
+#include "MCTSPlayer.h"
 #include "Population.h"
 #include "TicTacToe.h"
+#include "UltimateTTT.h"
 
-int main() {
-  srand((unsigned int)time(NULL));
+// Settings given on the command line besides the seed, game and checkpoint
+struct Options {
+  std::string checkpointPath;
+  bool lockstep;
+  // Train with the compiled-in topology: one hidden layer of twice the
+  // percepts. Any other topology falls back to the dynamic network.
+  bool fixedNet;
+  Precision precision;
+  unsigned int hofRecent;
+  unsigned int hofOlder;
+  size_t hofCapacity;
+  std::string metricsPath;
+  std::string tracePath;
+  // MCTS playouts per move as the training opponent, and for the benchmark
+  // after training; 0 for none. UltimateTTT only.
+  unsigned int mctsPlayouts;
+  unsigned int benchmarkPlayouts;
 
-  // Where your player log files are stored
-  std::string logFilePath = "data/";
+  Options()
+      : lockstep(false),
+        fixedNet(false),
+        precision(Precision::Double),
+        hofRecent(0),
+        hofOlder(0),
+        hofCapacity(0),
+        mctsPlayouts(0),
+        benchmarkPlayouts(0) {}
+};
 
+// Trains a population on Game, then offers to play and save the best player.
+// With a checkpoint path, a run saved there is resumed and the new state is
+// saved there every generation. A resumed run keeps the precision and hall
+// of fame sampling it was saved with.
+template <class Game>
+void run(const std::string &logFilePath, const Options &options) {
   Population pop;
-  pop.Init(TicTacToe::NUM_ACTIONS, std::cin, std::cout);
-  double trainingTime = pop.Train<TicTacToe>(false);
+  pop.SetHallOfFameCapacity(options.hofCapacity);
+  const std::string &checkpointPath = options.checkpointPath;
+  if (!checkpointPath.empty() && pop.Resume(checkpointPath)) {
+    std::cout << "Resumed from " << checkpointPath << " with seed "
+              << RandomStream::getRunSeed() << std::endl;
+  } else {
+    pop.Init(Game::NUM_PERCEPTS, std::cin, std::cout);
+    pop.SetPrecision(options.precision);
+    pop.SetHallOfFameSampling(options.hofRecent, options.hofOlder);
+  }
+  if (!checkpointPath.empty()) {
+    pop.SetCheckpoint(checkpointPath, 1);
+  }
+  if (options.lockstep) {
+    pop.SetEvaluationMode(EvaluationMode::Lockstep);
+  }
+  if (!options.metricsPath.empty()) {
+    size_t length = options.metricsPath.size();
+    bool csv = length >= 4 &&
+               options.metricsPath.compare(length - 4, 4, ".csv") == 0;
+    MetricsFormat format = csv ? MetricsFormat::Csv : MetricsFormat::JsonLines;
+    if (!pop.SetMetricsLog(options.metricsPath, format)) {
+      std::cout << "ERROR: Unable to open " << options.metricsPath
+                << std::endl;
+    }
+  }
+  if (!options.tracePath.empty()) {
+    pop.SetTrace(options.tracePath);
+  }
+  if (options.mctsPlayouts > 0) {
+    MCTSSettings settings;
+    settings.playouts = options.mctsPlayouts;
+    pop.SetMCTSOpponent(settings);
+  }
+
+  double trainingTime;
+  if (options.fixedNet) {
+    trainingTime = pop.Train<
+        Game, FixedNeuralNet<Game::NUM_PERCEPTS, 2 * Game::NUM_PERCEPTS, 1>>(
+        false);
+  } else {
+    trainingTime = pop.Train<Game>(false);
+  }
   std::cout << "Time to train: " << trainingTime << " seconds" << std::endl;
 
+  if (options.benchmarkPlayouts > 0) {
+    MCTSSettings settings;
+    settings.playouts = options.benchmarkPlayouts;
+    MCTSPlayer search(settings);
+    Statistics stats = pop.Benchmark<Game>(&search);
+    std::cout << "Against MCTS with " << settings.playouts
+              << " playouts: " << stats.winPercent << "% won, "
+              << stats.lossPercent << "% lost, " << stats.tiePercent
+              << "% tied" << std::endl;
+  }
+
   char input;
   std::cout << "Do you want to play against the best player? (y/n): ";
   std::cin >> input;
   if (input == 'y' || input == 'Y') {
-    pop.PlayBest<TicTacToe>();
+    pop.PlayBest<Game>();
   }
 
   std::cout << "Do you want to save the best player to a file? (y/n): ";
@@ -34,6 +119,103 @@ int main() {
                 << std::endl;
     }
   }
+}
+
+// Reads the options starting with "--" into 'options' and the rest into
+// 'positional'. Returns false on an unknown option or a missing value.
+bool parseArguments(int argc, char *argv[], Options &options,
+                    std::vector<std::string> &positional) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    int values = 0;
+    if (arg == "--hof-sample") {
+      values = 2;
+    } else if (arg == "--hof-capacity" || arg == "--metrics" ||
+               arg == "--trace" || arg == "--mcts" || arg == "--benchmark") {
+      values = 1;
+    }
+    if (i + values >= argc) {
+      std::cerr << "Error: " << arg << " needs " << values << " value(s)"
+                << std::endl;
+      return false;
+    }
+
+    if (arg.compare(0, 2, "--") != 0) {
+      positional.push_back(arg);
+    } else if (arg == "--lockstep") {
+      options.lockstep = true;
+    } else if (arg == "--fixed") {
+      options.fixedNet = true;
+    } else if (arg == "--float") {
+      options.precision = Precision::Float;
+    } else if (arg == "--hof-sample") {
+      options.hofRecent = (unsigned int)std::strtoul(argv[i + 1], NULL, 10);
+      options.hofOlder = (unsigned int)std::strtoul(argv[i + 2], NULL, 10);
+    } else if (arg == "--hof-capacity") {
+      options.hofCapacity = (size_t)std::strtoull(argv[i + 1], NULL, 10);
+    } else if (arg == "--metrics") {
+      options.metricsPath = argv[i + 1];
+    } else if (arg == "--trace") {
+      options.tracePath = argv[i + 1];
+    } else if (arg == "--mcts") {
+      options.mctsPlayouts = (unsigned int)std::strtoul(argv[i + 1], NULL, 10);
+    } else if (arg == "--benchmark") {
+      options.benchmarkPlayouts =
+          (unsigned int)std::strtoul(argv[i + 1], NULL, 10);
+    } else {
+      std::cerr << "Error: Unknown option " << arg << std::endl;
+      return false;
+    }
+    i += values;
+  }
+  return true;
+}
+
+// An optional first argument is the run seed, to repeat an earlier run.
+// A second argument of "ultimate" trains on UltimateTTT instead, and a
+// third names the checkpoint file to resume from and save to. Options may
+// come anywhere:
+//   --lockstep             batch network calls across games
+//   --fixed                use the compiled-in topology, see Options
+//   --float                run inference in single precision
+//   --hof-sample R O       play the R latest and O older champions
+//   --hof-capacity N       keep N champions in memory, spill the rest
+//   --metrics PATH         log each generation, as CSV if PATH ends in .csv
+//   --trace PATH           write a Chrome trace of training
+//   --mcts PLAYOUTS        train against MCTS (ultimate only)
+//   --benchmark PLAYOUTS   play the best player against MCTS (ultimate only)
+int main(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> positional;
+  if (!parseArguments(argc, argv, options, positional)) {
+    return 1;
+  }
+
+  uint64_t seed = (positional.size() > 0)
+                      ? std::strtoull(positional[0].c_str(), NULL, 10)
+                      : RandomStream::timeSeed();
+  RandomStream::setRunSeed(seed);
+  std::cout << "Seed: " << seed << std::endl;
+
+  // Where your player log files are stored
+  std::string logFilePath = "data/";
+
+  if (positional.size() > 2) {
+    options.checkpointPath = positional[2];
+  }
+
+  if (positional.size() > 1 && positional[1] == "ultimate") {
+    run<UltimateTTT>(logFilePath, options);
+  } else {
+    if (options.mctsPlayouts > 0 || options.benchmarkPlayouts > 0) {
+      std::cout << "MCTS only plays Ultimate TTT, ignoring --mcts and "
+                   "--benchmark"
+                << std::endl;
+      options.mctsPlayouts = 0;
+      options.benchmarkPlayouts = 0;
+    }
+    run<TicTacToe>(logFilePath, options);
+  }
 
   return 0;
 }
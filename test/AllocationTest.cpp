@@ -0,0 +1,92 @@
+/* Checks that NeuralNet::forward and playing games allocate nothing once
+ * the thread's NeuralNet workspace has grown to size. Every global operator
+ * new is counted; the program fails if any happen after the warm-up.
+ * AllocationTest.vcxproj builds it with the sources other than main.cpp and
+ * runs it after every build. Elsewhere, e.g.
+ *   g++ -std=c++14 -O2 -pthread -Iinclude -I<eigen> test/AllocationTest.cpp
+ *       $(ls src/*.cpp | grep -v main.cpp) -o AllocationTest
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "TicTacToe.h"
+#include "UltimateTTT.h"
+
+static std::atomic<long> allocations(0);
+
+void *operator new(size_t size) {
+  allocations++;
+  void *memory = std::malloc(size ? size : 1);
+  if (memory == NULL) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+// Allocations made by 'calls' single-row forward passes, after a first one.
+// The rows come both from a vector and from a column-major matrix.
+long countForwardAllocations(const std::vector<unsigned int> &layerSizes,
+                             int calls) {
+  RandomStream random = RandomStream::get(RandomPurpose::Player, 0, 0);
+  NeuralNet net(layerSizes, random);
+  MatrixXd inputs = MatrixXd::Random(8, layerSizes[0]);
+  RowVectorXd input = inputs.row(0);
+  double sum = net.forward(input)(0);
+
+  long before = allocations;
+  for (int i = 0; i < calls; ++i) {
+    sum += net.forward(input)(0);
+    sum += net.forward(inputs.row(i % 8))(0);
+  }
+  long count = allocations - before;
+  std::printf("Forward checksum: %.3f\n", sum);
+  return count;
+}
+
+// Allocations made by 'pairs' pairs of games, after 'warmUp' pairs
+template <class Game>
+long countAllocations(const std::vector<unsigned int> &layerSizes,
+                      int warmUp, int pairs) {
+  RandomStream random1 = RandomStream::get(RandomPurpose::Player, 0, 0);
+  RandomStream random2 = RandomStream::get(RandomPurpose::Player, 0, 1);
+  NeuralPlayer player1(layerSizes, random1);
+  NeuralPlayer player2(layerSizes, random2);
+  Game game1(&player1, &player2);
+  Game game2(&player2, &player1);
+
+  long before = 0;
+  for (int i = 0; i < warmUp + pairs; ++i) {
+    if (i == warmUp) {
+      before = allocations;
+    }
+    game1.playGame();
+    game1.Reset();
+    game2.playGame();
+    game2.Reset();
+  }
+  return allocations - before;
+}
+
+int main() {
+  long forward = countForwardAllocations({TicTacToe::NUM_PERCEPTS, 30, 1},
+                                         10000);
+  long tictactoe = countAllocations<TicTacToe>(
+      {TicTacToe::NUM_PERCEPTS, 30, 10, 1}, 10, 10000);
+  long ultimate = countAllocations<UltimateTTT>(
+      {UltimateTTT::NUM_PERCEPTS, 40, 1}, 10, 1000);
+  std::printf("Allocations: %ld in 20000 forward passes, %ld in 20000 "
+              "TicTacToe games, %ld in 2000 UltimateTTT games\n",
+              forward, tictactoe, ultimate);
+  if (forward != 0 || tictactoe != 0 || ultimate != 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  std::printf("PASSED\n");
+  return 0;
+}